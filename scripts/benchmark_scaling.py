@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+
+# Run the headless benchmark of the simulation on generated scenes of
+# increasing sizes, and collect the scaling curves (steps/s, p50/p99 step
+# time, peak memory) in machine readable files:
+#  - <output>.jsonl: one JSON object per scene, as written by --benchmark
+#  - <output>.csv: the main columns, one line per size
+#
+# Usage (from the root of the project, after the build):
+# $ python3 scripts/benchmark_scaling.py --executable build/SMG-Remake
+# $ python3 scripts/benchmark_scaling.py --sizes 10,100,1000 --steps 200
+
+import argparse
+import csv
+import json
+import os
+import subprocess
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import generate_stress_scene  # noqa: E402
+
+root = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+scene_directory = os.path.join(root, 'config', 'scenes', 'stress')
+
+
+def generate(size, types, seed):
+    # About a hundred shapes per planet, and a black hole for ten planets
+    planet_count = max(2, size // 100)
+    black_hole_count = max(1, planet_count // 10)
+    per_type = max(1, size // len(types))
+    scene = generate_stress_scene.generate_scene(
+        planet_count, black_hole_count, per_type, types, seed)
+
+    name = f'stress_{size:05d}.yaml'
+    os.makedirs(scene_directory, exist_ok=True)
+    with open(os.path.join(scene_directory, name), 'w') as file:
+        file.write('\n'.join(generate_stress_scene.write_yaml(scene)) + '\n')
+    return 'stress/' + name
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Scaling benchmark of the simulation')
+    parser.add_argument('--executable',
+                        default=os.path.join(root, 'build',
+                                             os.path.basename(root)))
+    parser.add_argument('--sizes', default='10,100,1000,10000',
+                        help='comma separated numbers of shapes')
+    parser.add_argument('--types', default='cube,cylinder,cone',
+                        help='primitive types of the shapes')
+    parser.add_argument('--steps', type=int, default=300)
+    parser.add_argument('--warmup', type=int, default=30)
+    parser.add_argument('--seed', type=int, default=0)
+    parser.add_argument('--output', default='benchmark_scaling')
+    args = parser.parse_args()
+
+    types = [t for t in args.types.split(',') if t]
+    sizes = [int(s) for s in args.sizes.split(',') if s]
+    jsonl_path = args.output + '.jsonl'
+    if os.path.exists(jsonl_path):
+        os.remove(jsonl_path)
+
+    for size in sizes:
+        scene = generate(size, types, args.seed)
+        command = [args.executable, scene, '--benchmark',
+                   '--steps', str(args.steps), '--warmup', str(args.warmup),
+                   '--output', os.path.abspath(jsonl_path)]
+        print(' '.join(command), flush=True)
+        # The scenes and assets are found from the root of the project
+        completed = subprocess.run(command, cwd=root)
+        if completed.returncode != 0:
+            print(f'Benchmark of {scene} failed ({completed.returncode})')
+            continue
+
+    results = []
+    if os.path.exists(jsonl_path):
+        with open(jsonl_path) as file:
+            results = [json.loads(line) for line in file if line.strip()]
+
+    columns = ['scene', 'deformables', 'vertices', 'planets', 'black_holes',
+               'steps', 'steps_per_second', 'step_ms_p50', 'step_ms_p99',
+               'peak_rss_bytes']
+    with open(args.output + '.csv', 'w', newline='') as file:
+        writer = csv.writer(file)
+        writer.writerow(columns)
+        for result in results:
+            writer.writerow([result['scene'], result['deformables'],
+                             result['vertices'], result['planets'],
+                             result['black_holes'], result['steps'],
+                             result['steps_per_second'],
+                             result['step_ms']['p50'],
+                             result['step_ms']['p99'],
+                             result['peak_rss_bytes']])
+
+    print(f'\n{"shapes":>8} {"steps/s":>10} {"p50 (ms)":>10} '
+          f'{"p99 (ms)":>10} {"peak RSS (MB)":>14}')
+    for result in results:
+        print(f'{result["deformables"]:>8} '
+              f'{result["steps_per_second"]:>10.1f} '
+              f'{result["step_ms"]["p50"]:>10.3f} '
+              f'{result["step_ms"]["p99"]:>10.3f} '
+              f'{result["peak_rss_bytes"] / 1e6:>14.1f}')
+    print(f'\nResults written to {jsonl_path} and {args.output}.csv')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,206 @@
+#!/usr/bin/env python3
+
+# Generate a scene with many planets, black holes and shapes, to measure how
+# the simulation scales. The planets and black holes are described in the
+# scene file itself, and the shapes are placed around the planets without
+# overlapping.
+#
+# Usage:
+# $ python3 scripts/generate_stress_scene.py --planets 20 --black-holes 4 \
+#       --deformables 100 --output config/scenes/stress/stress_0500.yaml
+# Then run the scene with its path relative to config/scenes/:
+# $ ./SMG-Remake stress/stress_0500.yaml
+
+import argparse
+import math
+import os
+import random
+
+primitive_types = ['cube', 'cylinder', 'cone', 'bunny', 'spot']
+
+# Distance between the planets of the grid
+planet_spacing = 7.0
+# Minimal distance between the centers of two shapes (about twice their size)
+shape_spacing = 0.45
+
+
+def vec3(x, y, z):
+    return {'x': round(x, 4), 'y': round(y, 4), 'z': round(z, 4)}
+
+
+def grid_positions(count, spacing, offset):
+    # Positions of a cubic grid holding count elements
+    side = max(1, math.ceil(count ** (1.0 / 3.0)))
+    positions = []
+    for k in range(count):
+        i, j, l = k % side, (k // side) % side, k // (side * side)
+        positions.append(tuple(spacing * c + offset for c in (i, j, l)))
+    return positions
+
+
+def random_direction(rng):
+    z = rng.uniform(-1.0, 1.0)
+    angle = rng.uniform(0.0, 2.0 * math.pi)
+    r = math.sqrt(1.0 - z * z)
+    return (r * math.cos(angle), r * math.sin(angle), z)
+
+
+def place_shapes(rng, planets, count, occupied):
+    # Rejection sampling in the attraction shells of the planets, with a hash
+    # grid to test the distance to the shapes already placed (and to the
+    # occupied positions)
+    cells = {}
+    positions = []
+
+    def cell(p):
+        return tuple(int(math.floor(c / shape_spacing)) for c in p)
+
+    def is_free(p):
+        ci = cell(p)
+        for dx in (-1, 0, 1):
+            for dy in (-1, 0, 1):
+                for dz in (-1, 0, 1):
+                    key = (ci[0] + dx, ci[1] + dy, ci[2] + dz)
+                    for q in cells.get(key, []):
+                        if math.dist(p, q) < shape_spacing:
+                            return False
+        return True
+
+    for p in occupied:
+        cells.setdefault(cell(p), []).append(p)
+
+    attempts = 0
+    while len(positions) < count:
+        attempts += 1
+        if attempts > 100 * count + 1000:
+            raise RuntimeError('Not enough room for the shapes: add planets')
+        planet = rng.choice(planets)
+        radius = rng.uniform(planet['radius'] + 0.3,
+                             0.9 * planet['attraction_radius'])
+        direction = random_direction(rng)
+        center = planet['center']
+        p = tuple(center[c] + radius * direction[c] for c in range(3))
+        if is_free(p):
+            positions.append(p)
+            cells.setdefault(cell(p), []).append(p)
+    return positions
+
+
+def generate_scene(planet_count, black_hole_count, deformables_per_type,
+                   types=primitive_types, seed=0, mutual_gravity=False):
+    rng = random.Random(seed)
+
+    planets = []
+    for center in grid_positions(planet_count, planet_spacing, 0.0):
+        radius = rng.uniform(0.5, 1.0)
+        planets.append({'center': center, 'radius': radius,
+                        'attraction_radius': 2.5 * radius + 0.5})
+
+    # The black holes are in the middle of the cells of the planet grid
+    black_holes = []
+    half = 0.5 * planet_spacing
+    for center in grid_positions(black_hole_count, planet_spacing, half):
+        black_holes.append({'center': center, 'radius': 0.5,
+                            'attraction_radius': 1.5})
+
+    first = planets[0]
+    player_position = (first['center'][0],
+                       first['center'][1] + first['radius'] + 0.3,
+                       first['center'][2])
+
+    shape_types = [t for t in types for _ in range(deformables_per_type)]
+    rng.shuffle(shape_types)
+    positions = place_shapes(rng, planets, len(shape_types),
+                             [player_position])
+    extent = planet_spacing * max(1, math.ceil(planet_count ** (1.0 / 3.0)))
+
+    scene = {
+        'id': 0,
+        'planets': [{'position': vec3(*p['center']),
+                     'radius': round(p['radius'], 4),
+                     'attraction_radius': round(p['attraction_radius'], 4)}
+                    for p in planets],
+        'black_holes': [{'position': vec3(*b['center']),
+                         'radius': b['radius'],
+                         'attraction_radius': b['attraction_radius']}
+                        for b in black_holes],
+        'player': {'position': vec3(*player_position),
+                   'size': vec3(0.07, 0.07, 0.2)},
+        'camera': {'eye': vec3(extent, extent, extent),
+                   'focus': vec3(0.0, 0.0, 0.0),
+                   'rotation_axis': vec3(0.0, 0.0, 0.0)},
+        'skybox': {'texture_path': 'galaxy-skybox.png',
+                   'distance_from_player': 50.0 + 2.0 * extent},
+        'deformables': [{'type': t, 'position': vec3(*p)}
+                        for t, p in zip(shape_types, positions)],
+    }
+    if mutual_gravity:
+        # The shapes also attract each other (asteroid field)
+        scene['mutual_gravity'] = {'enabled': True}
+    return scene
+
+
+def write_yaml(value, indent=0):
+    # Minimal writer for the nested dictionaries and lists of a scene (no
+    # dependency on PyYAML)
+    pad = '  ' * indent
+    lines = []
+    if isinstance(value, dict):
+        for key, item in value.items():
+            if isinstance(item, (dict, list)):
+                lines.append(f'{pad}{key}:')
+                lines.extend(write_yaml(item, indent + 1))
+            else:
+                lines.append(f'{pad}{key}: {format_scalar(item)}')
+    else:
+        for item in value:
+            if isinstance(item, dict):
+                item_lines = write_yaml(item, indent + 1)
+                # The first key goes on the line of the dash
+                lines.append(f'{pad}- {item_lines[0].lstrip()}')
+                lines.extend(item_lines[1:])
+            else:
+                lines.append(f'{pad}- {format_scalar(item)}')
+    return lines
+
+
+def format_scalar(value):
+    if isinstance(value, bool):
+        return 'true' if value else 'false'
+    if isinstance(value, str):
+        return f'"{value}"'
+    return str(value)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Generate a stress test scene')
+    parser.add_argument('--planets', type=int, default=10)
+    parser.add_argument('--black-holes', type=int, default=2)
+    parser.add_argument('--deformables', type=int, default=20,
+                        help='number of shapes of each primitive type')
+    parser.add_argument('--types', default=','.join(primitive_types),
+                        help='comma separated primitive types')
+    parser.add_argument('--seed', type=int, default=0)
+    parser.add_argument('--mutual-gravity', action='store_true',
+                        help='the shapes attract each other')
+    parser.add_argument('--output', required=True)
+    args = parser.parse_args()
+
+    types = [t for t in args.types.split(',') if t]
+    for t in types:
+        if t not in primitive_types:
+            parser.error(f'unknown primitive type {t}')
+
+    scene = generate_scene(args.planets, args.black_holes, args.deformables,
+                           types, args.seed, args.mutual_gravity)
+    os.makedirs(os.path.dirname(os.path.abspath(args.output)), exist_ok=True)
+    with open(args.output, 'w') as file:
+        file.write('\n'.join(write_yaml(scene)) + '\n')
+    print(f'Wrote {args.output}: {len(scene["planets"])} planets, '
+          f'{len(scene["black_holes"])} black holes, '
+          f'{len(scene["deformables"])} shapes')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+
+# Regression test of the physics: run the reference scenes for a fixed number
+# of steps and compare the particle positions with the golden files of
+# config/golden/, within a tolerance (maximum and RMS deviations are printed).
+#
+# The golden files are recorded once with the reference code path (a build
+# without ENABLE_AVX), then committed to config/golden/:
+# $ python3 scripts/golden_regression.py --record --backend reference \
+#       --steps 300
+# Any faster path (other solver backend, vector instructions, threads) is then
+# checked against them:
+# $ python3 scripts/golden_regression.py --backend threaded --tolerance 1e-3
+#
+# The exit code is not zero if a scene deviates (or could not be run).
+
+import argparse
+import os
+import subprocess
+import sys
+
+root = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+golden_directory = os.path.join(root, 'config', 'golden')
+
+# Scenes of config/scenes/ covering the planets, the black holes and the
+# collisions between shapes (golden_01 starts with shapes of each type
+# touching each other and the planets)
+reference_scenes = ['golden_01.yaml', 'scene_02.yaml']
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Golden state regression of the simulation')
+    parser.add_argument('--executable',
+                        default=os.path.join(root, 'build',
+                                             os.path.basename(root)))
+    parser.add_argument('--record', action='store_true',
+                        help='write the golden files instead of comparing')
+    parser.add_argument('--steps', type=int, default=300,
+                        help='steps of the recording')
+    parser.add_argument('--tolerance', type=float, default=1e-3,
+                        help='maximal deviation of a particle')
+    parser.add_argument('--scenes', default=','.join(reference_scenes),
+                        help='comma separated scene files')
+    parser.add_argument('--backend', default='',
+                        help='solver backend (default: the one of the scene)')
+    args = parser.parse_args()
+
+    os.makedirs(golden_directory, exist_ok=True)
+    failures = []
+    for scene in [s for s in args.scenes.split(',') if s]:
+        golden = os.path.join(golden_directory,
+                              os.path.splitext(scene)[0] + '.golden')
+        if args.record:
+            command = [args.executable, scene, '--golden-record', golden,
+                       '--steps', str(args.steps)]
+        else:
+            command = [args.executable, scene, '--golden-compare', golden,
+                       '--tolerance', str(args.tolerance)]
+        if args.backend:
+            command += ['--backend', args.backend]
+        print(' '.join(command), flush=True)
+        # The scenes and assets are found from the root of the project
+        completed = subprocess.run(command, cwd=root)
+        if completed.returncode != 0:
+            failures.append(scene)
+
+    if failures:
+        print(f'\nFailed: {", ".join(failures)}')
+        sys.exit(1)
+    print('\nAll the scenes ' + ('recorded' if args.record else 'passed'))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,59 @@
+#version 330 core
+
+// Vertex shader of the rigid shapes drawn with instancing - this code is
+// executed for every vertex of every instance of the shape
+
+// Inputs coming from VBOs
+layout (location = 0) in vec3 vertex_position; // vertex position in the rest shape (x,y,z)
+layout (location = 1) in vec3 vertex_normal;   // vertex normal in the rest shape   (nx,ny,nz)
+layout (location = 2) in vec3 vertex_color;    // vertex color      (r,g,b)
+layout (location = 3) in vec2 vertex_uv;       // vertex uv-texture (u,v)
+
+// Inputs coming from the per-instance VBOs (one value per shape)
+layout (location = 4) in vec3 instance_translation; // translation of the rigid transform
+layout (location = 5) in vec3 instance_rotation_x;  // first column of the rotation
+layout (location = 6) in vec3 instance_rotation_y;  // second column of the rotation
+layout (location = 7) in vec3 instance_rotation_z;  // third column of the rotation
+layout (location = 8) in vec3 instance_color;       // color of the shape
+
+// Output variables sent to the fragment shader
+out struct fragment_data
+{
+    vec3 position; // vertex position in world space
+    vec3 normal;   // normal position in world space
+    vec3 color;    // vertex color
+    vec2 uv;       // vertex uv
+} fragment;
+
+// Uniform variables expected to receive from the C++ program
+uniform mat4 model; // Model affine transform matrix applied after the transform of the instance
+uniform mat4 view;  // View matrix (rigid transform) of the camera
+uniform mat4 projection; // Projection (perspective or orthogonal) matrix of the camera
+
+
+
+void main()
+{
+	// Rigid transform of the instance: p = R p_rest + t
+	mat3 rotation = mat3(instance_rotation_x, instance_rotation_y, instance_rotation_z);
+
+	// The position of the vertex in the world space
+	vec4 position = model * vec4(rotation * vertex_position + instance_translation, 1.0);
+
+	// The normal of the vertex in the world space (the rotation doesn't need
+	// the inverse transpose)
+	mat4 modelNormal = transpose(inverse(model));
+	vec4 normal = modelNormal * vec4(rotation * vertex_normal, 0.0);
+
+	// The projected position of the vertex in the normalized device coordinates:
+	vec4 position_projected = projection * view * position;
+
+	// Fill the parameters sent to the fragment shader
+	fragment.position = position.xyz;
+	fragment.normal   = normal.xyz;
+	fragment.color = vertex_color * instance_color;
+	fragment.uv = vertex_uv;
+
+	// gl_Position is a built-in variable which is the expected output of the vertex shader
+	gl_Position = position_projected; // gl_Position is the projected vertex position (in normalized device coordinates)
+}
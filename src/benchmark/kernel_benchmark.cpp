@@ -0,0 +1,328 @@
+#include "benchmark/kernel_benchmark.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <random>
+
+#include <yaml-cpp/yaml.h>
+
+#include "environment.hpp"
+#include "objects/black_hole.hpp"
+#include "objects/planet.hpp"
+#include "profiling/profiler.hpp"
+#include "simulation/simulation_passes.hpp"
+
+using namespace cgp;
+
+namespace
+{
+    // Call setup (not measured) then kernel, repetitions times
+    template <typename Setup, typename Kernel>
+    timing_statistics measure(int repetitions, Setup setup, Kernel kernel)
+    {
+        std::vector<double> samples;
+        samples.reserve(repetitions);
+        for (int k = 0; k < repetitions; ++k)
+        {
+            setup();
+            const auto start = std::chrono::steady_clock::now();
+            kernel();
+            const std::chrono::duration<double, std::nano> elapsed =
+                std::chrono::steady_clock::now() - start;
+            samples.push_back(elapsed.count());
+        }
+        return timing_statistics::from_samples(samples);
+    }
+
+    mesh cube_mesh(int N_sample)
+    {
+        const float L = 0.1f;
+        return mesh_primitive_cubic_grid(
+            { -L, -L, -L }, { L, -L, -L }, { L, L, -L }, { -L, L, -L },
+            { -L, -L, L }, { L, -L, L }, { L, L, L }, { -L, L, L }, N_sample,
+            N_sample, N_sample);
+    }
+
+    mesh bunny_mesh()
+    {
+        mesh m = mesh_load_file_obj(project::path + "assets/bunny.obj");
+        m.scale(1.5f);
+        m.flip_connectivity();
+        return m.centered();
+    }
+
+    // Shape ready to be simulated with the time step of the parameters
+    shape_deformable_structure make_shape(const mesh &m, vec3 const &center,
+                                          simulation_parameter const &param)
+    {
+        shape_deformable_structure shape;
+        shape.initialize(m);
+        shape.set_position_and_velocity(center);
+        shape.position_predict = shape.position;
+        shape.com = center_of_mass(shape.position);
+        shape.step_dt = param.time_step;
+        shape.step_iterations = param.collision_steps;
+        return shape;
+    }
+
+    // Move the predicted positions randomly around the current ones
+    void perturb_prediction(shape_deformable_structure &shape, float amplitude,
+                            std::mt19937 &generator)
+    {
+        std::uniform_real_distribution<float> noise(-amplitude, amplitude);
+        for (int k = 0; k < shape.size(); ++k)
+        {
+            shape.position_predict[k] = shape.position[k]
+                + vec3(noise(generator), noise(generator), noise(generator));
+        }
+    }
+
+    // Predicted positions of all the shapes, to restore them before each call
+    std::vector<numarray<vec3>> save_predictions(
+        const deformable_store &deformables)
+    {
+        std::vector<numarray<vec3>> saved;
+        for (const shape_deformable_structure &shape : deformables)
+            saved.push_back(shape.position_predict);
+        return saved;
+    }
+
+    void restore_predictions(deformable_store &deformables,
+                             const std::vector<numarray<vec3>> &saved)
+    {
+        for (int k = 0; k < deformables.size(); ++k)
+            deformables[k].position_predict = saved[k];
+    }
+} // namespace
+
+std::vector<kernel_benchmark_result> run_kernel_benchmarks(
+    kernel_benchmark_parameter const &parameter)
+{
+    // Only the kernels are measured, not the profiler
+    const bool profiler_enabled = profiler.enabled;
+    profiler.enabled = false;
+
+    std::mt19937 generator(parameter.seed);
+    const int repetitions = parameter.repetitions;
+    simulation_parameter param;
+    // The repetitions restore the same positions: with the contact cache, all
+    // of them but the first would skip the search
+    param.contact_cache.enabled = false;
+    std::vector<kernel_benchmark_result> results;
+
+    // Polar decomposition of random matrices, by batches
+    {
+        const int N_matrix = 1024;
+        std::uniform_real_distribution<float> coefficient(-1.0f, 1.0f);
+        std::vector<mat3> matrices(N_matrix);
+        for (mat3 &M : matrices)
+        {
+            for (int i = 0; i < 3; ++i)
+                for (int j = 0; j < 3; ++j)
+                    M(i, j) = coefficient(generator);
+        }
+        mat3 sink = mat3::build_zero();
+        results.push_back(
+            { "polar_decomposition", N_matrix,
+              measure(repetitions, [] {},
+                      [&] {
+                          for (const mat3 &M : matrices)
+                              sink += polar_decomposition(M);
+                      }) });
+        // Keep the result alive: a volatile store can't be optimized out
+        volatile float kept = sink(0, 0);
+        (void)kept;
+    }
+
+    // Shape matching of a perturbed cube and bunny
+    {
+        const mesh shapes[] = { cube_mesh(5), bunny_mesh() };
+        const char *names[] = { "shape_matching/cube", "shape_matching/bunny" };
+        for (int s = 0; s < 2; ++s)
+        {
+            deformable_store deformables;
+            shape_deformable_structure shape =
+                make_shape(shapes[s], { 0, 0, 0 }, param);
+            perturb_prediction(shape, 0.02f, generator);
+            const int N_vertex = shape.size();
+            deformables.insert(std::move(shape));
+            const auto saved = save_predictions(deformables);
+            results.push_back(
+                { names[s], N_vertex,
+                  measure(repetitions,
+                          [&] { restore_predictions(deformables, saved); },
+                          [&] { shape_matching(deformables, param); }) });
+        }
+    }
+
+    // Two overlapping cubes of increasing resolutions
+    for (int N_sample : { 3, 5, 8, 12 })
+    {
+        deformable_store deformables;
+        const mesh m = cube_mesh(N_sample);
+        deformables.insert(make_shape(m, { 0, 0, 0 }, param));
+        deformables.insert(make_shape(m, { 0.1f, 0.05f, 0 }, param));
+        const auto saved = save_predictions(deformables);
+        bounding_box bbox[2];
+        compute_bounding_boxes(deformables, param, bbox);
+        const int N_vertex = deformables[0].size() + deformables[1].size();
+        results.push_back(
+            { "collision_between_particles/" + std::to_string(N_sample),
+              N_vertex,
+              measure(repetitions,
+                      [&] { restore_predictions(deformables, saved); },
+                      [&] {
+                          collision_between_particles(deformables, bbox,
+                                                      param);
+                      }) });
+    }
+
+    // Cubes sinking in the planets
+    std::vector<Planet> planets;
+    planets.emplace_back(1.0f, 2.0f, vec3(0, 0, 0));
+    planets.emplace_back(0.7f, 2.0f, vec3(2.5f, 0, 0));
+    {
+        deformable_store deformables;
+        std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+        const mesh m = cube_mesh(5);
+        for (int k = 0; k < 32; ++k)
+        {
+            const float a = angle(generator);
+            const float b = angle(generator);
+            const vec3 direction = { std::cos(a) * std::sin(b),
+                                     std::sin(a) * std::sin(b), std::cos(b) };
+            deformables.insert(make_shape(m, 1.02f * direction, param));
+        }
+        const auto saved = save_predictions(deformables);
+        std::vector<bounding_box> bbox(deformables.size());
+        compute_bounding_boxes(deformables, param, bbox.data());
+        StepArena arena;
+        int N_vertex = 0;
+        for (const shape_deformable_structure &shape : deformables)
+            N_vertex += shape.size();
+        results.push_back(
+            { "collision_with_planets", N_vertex,
+              measure(
+                  repetitions,
+                  [&] {
+                      restore_predictions(deformables, saved);
+                      arena.reset();
+                  },
+                  [&] {
+                      collision_with_planets(deformables, bbox.data(),
+                                             planets, param, arena);
+                  }) });
+    }
+
+    // Attraction of shapes around the planets and a black hole
+    {
+        SlotMap<BlackHole> black_holes;
+        black_holes.emplace(0.5f, 1.5f, vec3(-3.0f, 0, 0));
+        deformable_store deformables;
+        std::uniform_real_distribution<float> coordinate(-4.0f, 4.0f);
+        const mesh m = cube_mesh(5);
+        for (int k = 0; k < 64; ++k)
+        {
+            const vec3 center = { coordinate(generator), coordinate(generator),
+                                  coordinate(generator) };
+            deformables.insert(make_shape(m, center, param));
+        }
+        int N_vertex = 0;
+        for (const shape_deformable_structure &shape : deformables)
+            N_vertex += shape.size();
+        results.push_back(
+            { "planetary_attraction", N_vertex,
+              measure(repetitions, [] {},
+                      [&] {
+                          planetary_attraction(deformables, planets,
+                                               black_holes, param);
+                      }) });
+    }
+
+    // Normals of the bunny: generic normals of the library, and the gather
+    // over the precomputed adjacency of the shapes
+    {
+        shape_deformable_structure shape =
+            make_shape(bunny_mesh(), { 0, 0, 0 }, param);
+        perturb_prediction(shape, 0.02f, generator);
+        shape.position = shape.position_predict;
+        numarray<vec3> normals;
+        results.push_back(
+            { "normal_per_vertex/bunny", shape.size(),
+              measure(repetitions, [] {},
+                      [&] {
+                          normal_per_vertex(shape.position,
+                                            shape.connectivity, normals);
+                      }) });
+        results.push_back({ "update_normals/bunny", shape.size(),
+                            measure(repetitions, [] {},
+                                    [&] { shape.update_normals(); }) });
+    }
+
+    profiler.enabled = profiler_enabled;
+    return results;
+}
+
+void write_kernel_benchmark_json(
+    std::ostream &stream, const std::vector<kernel_benchmark_result> &results,
+    kernel_benchmark_parameter const &parameter)
+{
+    stream << "{\"seed\": " << parameter.seed
+           << ", \"repetitions\": " << parameter.repetitions
+           << ", \"kernels\": [\n";
+    for (int k = 0; k < results.size(); ++k)
+    {
+        const kernel_benchmark_result &result = results[k];
+        stream << "  {\"name\": \"" << result.name << "\""
+               << ", \"size\": " << result.size
+               << ", \"ns\": {\"average\": " << result.ns.average
+               << ", \"min\": " << result.ns.minimum
+               << ", \"p50\": " << result.ns.p50
+               << ", \"p99\": " << result.ns.p99 << "}}"
+               << (k + 1 < results.size() ? ",\n" : "\n");
+    }
+    stream << "]}\n";
+}
+
+void print_kernel_benchmark_summary(
+    std::ostream &stream, const std::vector<kernel_benchmark_result> &results,
+    const std::string &baseline_filename)
+{
+    // Median of each kernel of the baseline (JSON is read as YAML)
+    std::map<std::string, double> baseline;
+    if (!baseline_filename.empty())
+    {
+        const YAML::Node baseline_config = YAML::LoadFile(baseline_filename);
+        const YAML::Node kernels = baseline_config["kernels"];
+        for (auto kernel = kernels.begin(); kernel != kernels.end(); ++kernel)
+        {
+            baseline[(*kernel)["name"].as<std::string>()] =
+                (*kernel)["ns"]["p50"].as<double>();
+        }
+    }
+
+    char line[160];
+    std::snprintf(line, sizeof(line), "%-34s %8s %12s %12s %8s\n", "Kernel",
+                  "size", "p50 (us)", "base (us)", "speedup");
+    stream << line;
+    for (const kernel_benchmark_result &result : results)
+    {
+        const auto reference = baseline.find(result.name);
+        if (reference == baseline.end())
+        {
+            std::snprintf(line, sizeof(line), "%-34s %8d %12.3f\n",
+                          result.name.c_str(), result.size,
+                          result.ns.p50 / 1000.0);
+        }
+        else
+        {
+            std::snprintf(line, sizeof(line),
+                          "%-34s %8d %12.3f %12.3f %7.2fx\n",
+                          result.name.c_str(), result.size,
+                          result.ns.p50 / 1000.0, reference->second / 1000.0,
+                          reference->second / result.ns.p50);
+        }
+        stream << line;
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "benchmark/timing_statistics.hpp"
+
+struct kernel_benchmark_parameter
+{
+    // Seed of the random inputs: each run measures the kernels on the same
+    // data
+    unsigned seed = 42;
+    // Measured calls of each kernel (the inputs are restored before each
+    // call, out of the measure)
+    int repetitions = 200;
+};
+
+// Durations (ns) of the calls of a kernel on a given input
+struct kernel_benchmark_result
+{
+    std::string name;
+    // Number of elements processed by a call (vertices, matrices...)
+    int size = 0;
+    timing_statistics ns;
+};
+
+// Time each kernel of the solver in isolation: polar decomposition, shape
+// matching, collisions between particles and with the planets, planetary
+// attraction and normals. Needs an OpenGL context (the shapes and planets
+// create their drawables).
+std::vector<kernel_benchmark_result> run_kernel_benchmarks(
+    kernel_benchmark_parameter const &parameter);
+
+void write_kernel_benchmark_json(
+    std::ostream &stream, const std::vector<kernel_benchmark_result> &results,
+    kernel_benchmark_parameter const &parameter);
+
+// Print the median duration of each kernel, and its ratio to the one of a
+// previous run (JSON file written by write_kernel_benchmark_json) if given
+void print_kernel_benchmark_summary(
+    std::ostream &stream, const std::vector<kernel_benchmark_result> &results,
+    const std::string &baseline_filename);
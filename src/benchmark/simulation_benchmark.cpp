@@ -0,0 +1,79 @@
+#include "benchmark/simulation_benchmark.hpp"
+
+#include <chrono>
+#include <vector>
+
+#include "benchmark/timing_statistics.hpp"
+#include "profiling/memory_usage.hpp"
+#include "profiling/profiler.hpp"
+
+benchmark_result run_simulation_benchmark(scene_structure &scene,
+                                          const std::string &scene_name,
+                                          benchmark_parameter const &parameter)
+{
+    for (int step = 0; step < parameter.warmup_steps; ++step)
+    {
+        scene.simulate_frame();
+        profiler.end_frame();
+    }
+
+    std::vector<double> step_times;
+    step_times.reserve(parameter.steps);
+    for (int step = 0; step < parameter.steps; ++step)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        scene.simulate_frame();
+        const std::chrono::duration<double, std::milli> elapsed =
+            std::chrono::steady_clock::now() - start;
+        step_times.push_back(elapsed.count());
+        profiler.end_frame();
+    }
+
+    benchmark_result result;
+    result.scene = scene_name;
+    result.deformables = scene.deformables.size();
+    for (const shape_deformable_structure &deformable : scene.deformables)
+    {
+        result.vertices += deformable.size();
+    }
+    result.planets = scene.planets.size();
+    result.black_holes = scene.black_holes.size();
+
+    const timing_statistics statistics =
+        timing_statistics::from_samples(step_times);
+    result.steps = statistics.count;
+    result.steps_per_second =
+        statistics.total > 0.0 ? 1000.0 * statistics.count / statistics.total
+                               : 0.0;
+    result.step_average = statistics.average;
+    result.step_p50 = statistics.p50;
+    result.step_p99 = statistics.p99;
+    result.step_max = statistics.maximum;
+    result.peak_resident_memory = peak_resident_memory();
+    return result;
+}
+
+void write_benchmark_json(std::ostream &stream,
+                          benchmark_result const &result)
+{
+    stream << "{\"scene\": \"" << result.scene << "\""
+           << ", \"deformables\": " << result.deformables
+           << ", \"vertices\": " << result.vertices
+           << ", \"planets\": " << result.planets
+           << ", \"black_holes\": " << result.black_holes
+           << ", \"steps\": " << result.steps
+           << ", \"steps_per_second\": " << result.steps_per_second
+           << ", \"step_ms\": {\"average\": " << result.step_average
+           << ", \"p50\": " << result.step_p50
+           << ", \"p99\": " << result.step_p99
+           << ", \"max\": " << result.step_max << "}"
+           << ", \"peak_rss_bytes\": " << result.peak_resident_memory
+           << ", \"phase_average_ms\": {";
+    for (int phase = 0; phase < phase_count; ++phase)
+    {
+        stream << (phase > 0 ? ", " : "") << "\""
+               << profiler_structure::phase_name(profiler_phase_enum(phase))
+               << "\": " << profiler.time_statistics[phase].average();
+    }
+    stream << "}}\n";
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+
+#include "scene.hpp"
+
+struct benchmark_parameter
+{
+    // Steps run before the measures (allocations, settling of the shapes)
+    int warmup_steps = 50;
+    // Measured steps
+    int steps = 500;
+};
+
+// Measures of a headless run of the simulation of a scene
+struct benchmark_result
+{
+    std::string scene;
+    int deformables = 0;
+    int vertices = 0;
+    int planets = 0;
+    int black_holes = 0;
+
+    int steps = 0;
+    double steps_per_second = 0.0;
+    // Durations of a simulation step (ms)
+    double step_average = 0.0;
+    double step_p50 = 0.0;
+    double step_p99 = 0.0;
+    double step_max = 0.0;
+    // Peak resident memory of the process (bytes, -1 if unknown)
+    long long peak_resident_memory = -1;
+};
+
+// Run the simulation of the initialized scene without drawing it, and time
+// each of its steps
+benchmark_result run_simulation_benchmark(scene_structure &scene,
+                                          const std::string &scene_name,
+                                          benchmark_parameter const &parameter);
+
+// Write the result as a single line JSON object, with the average duration of
+// each phase of the profiler (last steps)
+void write_benchmark_json(std::ostream &stream,
+                          benchmark_result const &result);
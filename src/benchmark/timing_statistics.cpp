@@ -0,0 +1,30 @@
+#include "benchmark/timing_statistics.hpp"
+
+#include <algorithm>
+
+// Value below which the given ratio of the sorted values falls
+static double sorted_percentile(const std::vector<double> &sorted,
+                                double ratio)
+{
+    const int index = std::clamp(int(ratio * (sorted.size() - 1) + 0.5), 0,
+                                 int(sorted.size()) - 1);
+    return sorted[index];
+}
+
+timing_statistics timing_statistics::from_samples(std::vector<double> samples)
+{
+    timing_statistics statistics;
+    statistics.count = samples.size();
+    if (samples.empty())
+        return statistics;
+
+    for (double sample : samples)
+        statistics.total += sample;
+    std::sort(samples.begin(), samples.end());
+    statistics.average = statistics.total / statistics.count;
+    statistics.minimum = samples.front();
+    statistics.p50 = sorted_percentile(samples, 0.5);
+    statistics.p99 = sorted_percentile(samples, 0.99);
+    statistics.maximum = samples.back();
+    return statistics;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <vector>
+
+// Summary of the durations measured by a benchmark (in the unit of the
+// samples)
+struct timing_statistics
+{
+    int count = 0;
+    double total = 0.0;
+    double average = 0.0;
+    double minimum = 0.0;
+    double p50 = 0.0;
+    double p99 = 0.0;
+    double maximum = 0.0;
+
+    static timing_statistics from_samples(std::vector<double> samples);
+};
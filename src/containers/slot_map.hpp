@@ -0,0 +1,191 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Stable reference to an element of a SlotMap. It stays valid while the
+// element exists, whatever the insertions and removals of other elements, and
+// is detected as stale once the element has been removed.
+struct slot_handle
+{
+    static constexpr std::uint32_t null_index = 0xFFFFFFFF;
+
+    std::uint32_t index = null_index;
+    std::uint32_t generation = 0;
+
+    bool is_null() const
+    {
+        return index == null_index;
+    }
+
+    bool operator==(const slot_handle &other) const
+    {
+        return index == other.index && generation == other.generation;
+    }
+
+    bool operator!=(const slot_handle &other) const
+    {
+        return !(*this == other);
+    }
+};
+
+// Container giving O(1) insertion, removal and access by handle, while the
+// elements stay contiguous for the iterations (in no particular order).
+//  - The elements are densely stored: a removal moves the last element in
+//    place of the removed one (swap-and-pop).
+//  - Each handle refers to a slot storing the current dense index of its
+//    element, and a generation counter incremented at each removal so that
+//    old handles to a reused slot are rejected.
+template <typename T>
+class SlotMap
+{
+public:
+    using iterator = typename std::vector<T>::iterator;
+    using const_iterator = typename std::vector<T>::const_iterator;
+
+    template <typename... Args>
+    slot_handle emplace(Args &&...args)
+    {
+        std::uint32_t slot_index;
+        if (_free_slots.empty())
+        {
+            slot_index = std::uint32_t(_slots.size());
+            _slots.push_back({ 0, 0 });
+        }
+        else
+        {
+            slot_index = _free_slots.back();
+            _free_slots.pop_back();
+        }
+
+        _slots[slot_index].dense_index = std::uint32_t(_dense.size());
+        _dense.emplace_back(std::forward<Args>(args)...);
+        _dense_to_slot.push_back(slot_index);
+
+        return { slot_index, _slots[slot_index].generation };
+    }
+
+    slot_handle insert(T value)
+    {
+        return emplace(std::move(value));
+    }
+
+    // Remove the element, return false if the handle is stale
+    bool erase(slot_handle handle)
+    {
+        if (!contains(handle))
+            return false;
+
+        slot &removed_slot = _slots[handle.index];
+        const std::uint32_t dense_index = removed_slot.dense_index;
+        const std::uint32_t last_index = std::uint32_t(_dense.size() - 1);
+
+        // Move the last element in the hole and update its slot
+        if (dense_index != last_index)
+        {
+            _dense[dense_index] = std::move(_dense[last_index]);
+            _dense_to_slot[dense_index] = _dense_to_slot[last_index];
+            _slots[_dense_to_slot[dense_index]].dense_index = dense_index;
+        }
+        _dense.pop_back();
+        _dense_to_slot.pop_back();
+
+        // Invalidate the handles to this slot and recycle it
+        ++removed_slot.generation;
+        _free_slots.push_back(handle.index);
+        return true;
+    }
+
+    void clear()
+    {
+        for (std::uint32_t slot_index : _dense_to_slot)
+        {
+            ++_slots[slot_index].generation;
+            _free_slots.push_back(slot_index);
+        }
+        _dense.clear();
+        _dense_to_slot.clear();
+    }
+
+    bool contains(slot_handle handle) const
+    {
+        return handle.index < _slots.size()
+            && _slots[handle.index].generation == handle.generation
+            && !handle.is_null();
+    }
+
+    // Return the element referred by the handle, nullptr if it is stale
+    T *get(slot_handle handle)
+    {
+        return contains(handle) ? &_dense[_slots[handle.index].dense_index]
+                                : nullptr;
+    }
+
+    const T *get(slot_handle handle) const
+    {
+        return contains(handle) ? &_dense[_slots[handle.index].dense_index]
+                                : nullptr;
+    }
+
+    // Handle of the element stored at the given dense index
+    slot_handle handle_at(std::size_t dense_index) const
+    {
+        const std::uint32_t slot_index = _dense_to_slot[dense_index];
+        return { slot_index, _slots[slot_index].generation };
+    }
+
+    // Access by dense index, for the iterations over all the elements
+    T &operator[](std::size_t dense_index)
+    {
+        return _dense[dense_index];
+    }
+
+    const T &operator[](std::size_t dense_index) const
+    {
+        return _dense[dense_index];
+    }
+
+    std::size_t size() const
+    {
+        return _dense.size();
+    }
+
+    bool empty() const
+    {
+        return _dense.empty();
+    }
+
+    iterator begin()
+    {
+        return _dense.begin();
+    }
+
+    iterator end()
+    {
+        return _dense.end();
+    }
+
+    const_iterator begin() const
+    {
+        return _dense.begin();
+    }
+
+    const_iterator end() const
+    {
+        return _dense.end();
+    }
+
+private:
+    struct slot
+    {
+        std::uint32_t dense_index;
+        std::uint32_t generation;
+    };
+
+    std::vector<T> _dense;
+    // Slot of each dense element (to update it when the element moves)
+    std::vector<std::uint32_t> _dense_to_slot;
+    std::vector<slot> _slots;
+    std::vector<std::uint32_t> _free_slots;
+};
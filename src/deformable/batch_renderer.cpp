@@ -0,0 +1,260 @@
+#include "deformable/batch_renderer.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+using namespace cgp;
+
+void BatchRenderer::initialize(const opengl_shader_structure &shader)
+{
+    _shader = shader;
+    _wireframe_material.color = { 0, 0, 1 };
+    _wireframe_material.phong = { 1, 0, 0, 1 };
+
+    glGenVertexArrays(1, &_vao);
+    glGenBuffers(1, &_vbo);
+    glGenBuffers(1, &_ebo);
+
+    // Same attribute locations as the mesh shader
+    glBindVertexArray(_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(batch_vertex),
+                          (void *)offsetof(batch_vertex, position));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(batch_vertex),
+                          (void *)offsetof(batch_vertex, normal));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(batch_vertex),
+                          (void *)offsetof(batch_vertex, color));
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ebo);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    reserve(16 * 1024);
+}
+
+void BatchRenderer::reserve(int region_capacity)
+{
+    // The previous draws may still read the old buffer: orphan it
+    for (GLsync &fence : _fences)
+    {
+        if (fence != nullptr)
+            glDeleteSync(fence);
+        fence = nullptr;
+    }
+    _region_capacity = region_capacity;
+
+    const GLsizeiptr size = GLsizeiptr(region_count) * region_capacity
+        * sizeof(batch_vertex);
+    glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+#if defined(CGP_OPENGL_4_6)
+    // Immutable storage: a new buffer object is needed to change its size
+    if (_mapped != nullptr)
+    {
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        glDeleteBuffers(1, &_vbo);
+        glGenBuffers(1, &_vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+        glBindVertexArray(_vao);
+        for (GLuint location = 0; location < 3; ++location)
+        {
+            glVertexAttribPointer(
+                location, 3, GL_FLOAT, GL_FALSE, sizeof(batch_vertex),
+                (void *)(location * sizeof(vec3)));
+        }
+        glBindVertexArray(0);
+    }
+    const GLbitfield flags =
+        GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+    _mapped = static_cast<batch_vertex *>(
+        glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags));
+#else
+    glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+#endif
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void BatchRenderer::update_layout(const deformable_store &deformables,
+                                  const std::vector<int> &shape_indices)
+{
+    const int N_shape = shape_indices.size();
+    _layout.resize(N_shape);
+    _vertex_offsets.resize(N_shape);
+    _index_counts.resize(N_shape);
+    _index_offsets.resize(N_shape);
+    _base_vertices.resize(N_shape);
+
+    std::vector<GLuint> indices;
+    _vertex_count = 0;
+    for (int k = 0; k < N_shape; ++k)
+    {
+        const shape_deformable_structure &deformable =
+            deformables[shape_indices[k]];
+        _layout[k] = deformables.handle_at(shape_indices[k]);
+        _vertex_offsets[k] = _vertex_count;
+        _index_counts[k] = 3 * deformable.connectivity.size();
+        _index_offsets[k] =
+            (const void *)(std::uintptr_t(indices.size()) * sizeof(GLuint));
+
+        // The indices stay local to the shape, the base vertex of the draw
+        // gives its position in the buffer
+        for (const uint3 &triangle : deformable.connectivity)
+        {
+            indices.push_back(triangle[0]);
+            indices.push_back(triangle[1]);
+            indices.push_back(triangle[2]);
+        }
+        _vertex_count += deformable.size();
+    }
+
+    glBindVertexArray(_vao);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint),
+                 indices.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+}
+
+void BatchRenderer::update(const deformable_store &deformables,
+                           const std::vector<int> &shape_indices,
+                           TaskPool &pool)
+{
+    // Only rebuild the indices when the shapes have changed
+    bool same_layout = shape_indices.size() == _layout.size();
+    for (int k = 0; same_layout && k < shape_indices.size(); ++k)
+    {
+        same_layout = deformables.handle_at(shape_indices[k]) == _layout[k];
+    }
+    if (!same_layout)
+    {
+        update_layout(deformables, shape_indices);
+    }
+    if (_vertex_count == 0)
+    {
+        return;
+    }
+    if (_vertex_count > _region_capacity)
+    {
+        reserve(2 * _vertex_count);
+    }
+
+    // Wait for the GPU to be done with the region (drawn three frames ago)
+    GLsync &fence = _fences[_region];
+    if (fence != nullptr)
+    {
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                         GLuint64(1000000000));
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+#if defined(CGP_OPENGL_4_6)
+    batch_vertex *vertices = _mapped + _region * _region_capacity;
+#else
+    const GLintptr region_offset =
+        GLintptr(_region) * _region_capacity * sizeof(batch_vertex);
+    glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+    batch_vertex *vertices = static_cast<batch_vertex *>(glMapBufferRange(
+        GL_ARRAY_BUFFER, region_offset, _vertex_count * sizeof(batch_vertex),
+        GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT
+            | GL_MAP_INVALIDATE_RANGE_BIT));
+#endif
+
+    // The shapes are written directly in the mapped memory, in parallel
+    const int N_shape = shape_indices.size();
+    pool.parallel_for(N_shape, 4, [&](int begin, int end) {
+        for (int k = begin; k < end; ++k)
+        {
+            const shape_deformable_structure &deformable =
+                deformables[shape_indices[k]];
+            batch_vertex *shape_vertices = vertices + _vertex_offsets[k];
+            for (int i = 0; i < deformable.size(); ++i)
+            {
+                shape_vertices[i].position = deformable.position[i];
+                shape_vertices[i].normal = deformable.normal[i];
+                shape_vertices[i].color = deformable.vertex_color[i];
+            }
+        }
+    });
+
+#if !defined(CGP_OPENGL_4_6)
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+#endif
+
+    for (int k = 0; k < N_shape; ++k)
+    {
+        _base_vertices[k] = _region * _region_capacity + _vertex_offsets[k];
+    }
+    _drawn_region = _region;
+    _region = (_region + 1) % region_count;
+}
+
+void BatchRenderer::send_uniforms(const environment_structure &environment,
+                                  const material_mesh_structure &material) const
+{
+    environment.send_opengl_uniform(_shader, false);
+    opengl_uniform(_shader, "model", mat4::build_identity(), false);
+    opengl_uniform(_shader, "material.color", material.color, false);
+    opengl_uniform(_shader, "material.alpha", material.alpha, false);
+    opengl_uniform(_shader, "material.phong.ambient", material.phong.ambient,
+                   false);
+    opengl_uniform(_shader, "material.phong.diffuse", material.phong.diffuse,
+                   false);
+    opengl_uniform(_shader, "material.phong.specular",
+                   material.phong.specular, false);
+    opengl_uniform(_shader, "material.phong.specular_exponent",
+                   material.phong.specular_exponent, false);
+    opengl_uniform(_shader, "material.texture_settings.use_texture", false,
+                   false);
+    opengl_uniform(_shader, "material.texture_settings.two_sided",
+                   material.texture_settings.two_sided, false);
+}
+
+void BatchRenderer::draw(const environment_structure &environment,
+                         bool wireframe)
+{
+    if (_layout.empty() || _vertex_count == 0)
+    {
+        return;
+    }
+
+    glUseProgram(_shader.id);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, mesh_drawable::default_texture.id);
+    opengl_uniform(_shader, "image_texture", 0, false);
+    glBindVertexArray(_vao);
+    // No texture: constant uv
+    glVertexAttrib2f(3, 0.0f, 0.0f);
+
+    send_uniforms(environment, _material);
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, _index_counts.data(),
+                                  GL_UNSIGNED_INT, _index_offsets.data(),
+                                  _layout.size(), _base_vertices.data());
+
+    if (wireframe)
+    {
+        // Uniform color: the vertex colors are replaced by a constant
+        send_uniforms(environment, _wireframe_material);
+        glDisableVertexAttribArray(2);
+        glVertexAttrib3f(2, 1.0f, 1.0f, 1.0f);
+        glEnable(GL_POLYGON_OFFSET_LINE);
+        glPolygonOffset(-1.0f, -1.0f);
+        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, _index_counts.data(),
+                                      GL_UNSIGNED_INT, _index_offsets.data(),
+                                      _layout.size(), _base_vertices.data());
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        glDisable(GL_POLYGON_OFFSET_LINE);
+        glEnableVertexAttribArray(2);
+    }
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+
+    // The region can be written again once these draws are done
+    GLsync &fence = _fences[_drawn_region];
+    if (fence != nullptr)
+        glDeleteSync(fence);
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vector>
+
+#include "cgp/cgp.hpp"
+#include "deformable/deformable.hpp"
+#include "environment.hpp"
+#include "scheduling/task_pool.hpp"
+
+// Draws all the deformable shapes from a single vertex buffer with one
+// multi-draw call, instead of two buffer uploads and one draw call per shape.
+//  - The vertex buffer is split in three regions used in turn by the frames.
+//    A fence guards each region so that the CPU never writes vertices the GPU
+//    is still reading, without waiting for the last frame (triple buffering).
+//  - With OpenGL 4.6 the buffer is persistently mapped once; otherwise each
+//    region is mapped unsynchronized at each frame (OpenGL 3.3).
+//  - The index buffer only changes when the set of drawn shapes changes.
+// The textured shapes are not supported: they keep their own drawable.
+class BatchRenderer
+{
+public:
+    static constexpr int region_count = 3;
+
+    void initialize(const cgp::opengl_shader_structure &shader);
+
+    // Write the positions, normals and colors of the given shapes (dense
+    // indices in the deformables) in the next region of the buffer, the
+    // shapes being split over the workers of the pool
+    void update(const deformable_store &deformables,
+                const std::vector<int> &shape_indices, TaskPool &pool);
+
+    // Draw the shapes of the last update (and their wireframe if asked)
+    void draw(const environment_structure &environment, bool wireframe);
+
+private:
+    struct batch_vertex
+    {
+        cgp::vec3 position;
+        cgp::vec3 normal;
+        cgp::vec3 color;
+    };
+
+    // Reallocate the vertex buffer for regions of the given number of
+    // vertices
+    void reserve(int region_capacity);
+    // Rebuild the index buffer and the draw commands for the given shapes
+    void update_layout(const deformable_store &deformables,
+                       const std::vector<int> &shape_indices);
+    void send_uniforms(const environment_structure &environment,
+                       const cgp::material_mesh_structure &material) const;
+
+    cgp::opengl_shader_structure _shader;
+    cgp::material_mesh_structure _material;
+    cgp::material_mesh_structure _wireframe_material;
+
+    GLuint _vao = 0;
+    GLuint _vbo = 0;
+    GLuint _ebo = 0;
+    // Fence of the last draw reading each region
+    GLsync _fences[region_count] = {};
+    // Region written by the next update, and the one to draw
+    int _region = 0;
+    int _drawn_region = 0;
+    // Number of vertices of each region
+    int _region_capacity = 0;
+#if defined(CGP_OPENGL_4_6)
+    batch_vertex *_mapped = nullptr;
+#endif
+
+    // Handles of the shapes of the current layout, in drawing order
+    std::vector<slot_handle> _layout;
+    // First vertex of each shape in a region
+    std::vector<int> _vertex_offsets;
+    int _vertex_count = 0;
+    // Arguments of the multi-draw call
+    std::vector<GLsizei> _index_counts;
+    std::vector<const void *> _index_offsets;
+    std::vector<GLint> _base_vertices;
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+
+#include "cgp/cgp.hpp"
+#include "containers/slot_map.hpp"
+#include "deformable/sphere_tree.hpp"
+
+// Contacts of a shape found by the last search of its particles. A search
+// keeps the particles closer than the contact distance plus a skin distance:
+// the list still holds all the contacts as long as the shapes have moved by
+// less than the skin since the search (bounded from the placements of their
+// sphere trees). The list is reused across the collision iterations and the
+// steps until then, so that resting shapes are not searched again.
+
+// Particle pairs of the shape and another one
+struct particle_contact_cache
+{
+    // Other shape of the pair
+    slot_handle other;
+    // Placements of the sphere trees of the two shapes at the search
+    sphere_tree_placement placement;
+    sphere_tree_placement other_placement;
+    // Pairs of particles (of the shape, of the other shape)
+    std::vector<int> particles;
+    std::vector<int> other_particles;
+    // Direction from the particle to the other one at their last contact,
+    // kept to separate them if they coincide
+    std::vector<cgp::vec3> normals;
+    // Whether the pair of shapes has been tested since the start of the last
+    // step (the others are forgotten)
+    bool used = true;
+};
+
+// Particles of the shape close to the planets
+struct planet_contact_cache
+{
+    // Placement of the sphere tree at the search (invalid before the first
+    // search)
+    sphere_tree_placement placement;
+    // Planets touching the shape at the search (indices in the planets)
+    std::vector<int> planets;
+    // Particles close to one of these planets
+    std::vector<int> particles;
+    // Predicted positions of the particles, gathered for the contact kernel
+    cgp::numarray<cgp::vec3> positions;
+};
@@ -9,10 +9,49 @@ void shape_deformable_structure::initialize(cgp::mesh const &shape)
     position_predict = position;
     normal = shape.normal;
     connectivity = shape.connectivity;
+    vertex_color = shape.color;
+    if (vertex_color.size() != position.size())
+    {
+        vertex_color.resize(position.size());
+        vertex_color.fill({ 1, 1, 1 });
+    }
+    triangle_normal.resize(connectivity.size());
+
+    // Vertex to triangles adjacency: count the triangles of each vertex, then
+    // fill the rows
+    const int N_vertex = position.size();
+    vertex_triangle_offset.assign(N_vertex + 1, 0);
+    for (const cgp::uint3 &triangle : connectivity)
+    {
+        for (int c = 0; c < 3; ++c)
+        {
+            ++vertex_triangle_offset[triangle[c] + 1];
+        }
+    }
+    for (int k = 0; k < N_vertex; ++k)
+    {
+        vertex_triangle_offset[k + 1] += vertex_triangle_offset[k];
+    }
+    vertex_triangles.resize(vertex_triangle_offset[N_vertex]);
+    std::vector<int> next = vertex_triangle_offset;
+    for (int t = 0; t < connectivity.size(); ++t)
+    {
+        for (int c = 0; c < 3; ++c)
+        {
+            vertex_triangles[next[connectivity[t][c]]++] = t;
+        }
+    }
 
     velocity.resize(position.size());
     com = average(position);
     com_reference = average(position_reference);
+    com_rest = com_reference;
+    sphere_tree.build(position_reference, com_rest);
+    tree_placement = sphere_tree_placement();
+    rest_rotation = cgp::mat3::build_identity();
+    rest_margin = -1.0f;
+    particle_contacts.clear();
+    planet_contacts = planet_contact_cache();
 }
 
 void shape_deformable_structure::set_position_and_velocity(
@@ -39,9 +78,42 @@ int shape_deformable_structure::size() const
     return position.size();
 }
 
-void shape_deformable_structure::update_drawable()
+void shape_deformable_structure::update_normals()
+{
+    // Normal of each triangle, weighted by its area
+    const int N_triangle = connectivity.size();
+    for (int t = 0; t < N_triangle; ++t)
+    {
+        const cgp::uint3 &triangle = connectivity[t];
+        const cgp::vec3 &p0 = position[triangle[0]];
+        triangle_normal[t] =
+            cross(position[triangle[1]] - p0, position[triangle[2]] - p0);
+    }
+
+    // Each vertex gathers the normals of its triangles: no write conflicts
+    // between the vertices
+    const int N_vertex = size();
+    for (int k = 0; k < N_vertex; ++k)
+    {
+        cgp::vec3 n = { 0, 0, 0 };
+        for (int j = vertex_triangle_offset[k];
+             j < vertex_triangle_offset[k + 1]; ++j)
+        {
+            n += triangle_normal[vertex_triangles[j]];
+        }
+        const float length = norm(n);
+        normal[k] = length > 1e-10f ? n / length : cgp::vec3(0, 0, 1);
+    }
+}
+
+void shape_deformable_structure::upload_drawable()
 {
     drawable.vbo_position.update(position);
-    normal_per_vertex(position, connectivity, normal);
     drawable.vbo_normal.update(normal);
 }
+
+void shape_deformable_structure::update_drawable()
+{
+    update_normals();
+    upload_drawable();
+}
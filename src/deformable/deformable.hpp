@@ -1,6 +1,11 @@
 #pragma once
 
+#include <vector>
+
 #include "cgp/cgp.hpp"
+#include "containers/slot_map.hpp"
+#include "deformable/contact_cache.hpp"
+#include "deformable/sphere_tree.hpp"
 #include "objects/black_hole.hpp"
 
 // Structure storing the data for the deformable structure simulation
@@ -21,6 +26,21 @@ struct shape_deformable_structure
     cgp::numarray<cgp::vec3> position_predict;
     // Positions of the reference shape
     cgp::numarray<cgp::vec3> position_reference;
+    // Center of mass of the reference shape, as it was initialized
+    cgp::vec3 com_rest;
+    // Bounding spheres of the reference shape, and their placement on the
+    // predicted positions (refit by the shape matching)
+    SphereTree sphere_tree;
+    sphere_tree_placement tree_placement;
+    // Rotation from the reference shape to the positions at the start of the
+    // step, and largest distance of a position to the reference shape placed
+    // this way (negative until measured during the step)
+    cgp::mat3 rest_rotation = cgp::mat3::build_identity();
+    float rest_margin = -1.0f;
+    // Contacts with the other shapes (one entry per pair, stored in one of the
+    // two shapes) and with the planets, kept across the steps
+    std::vector<particle_contact_cache> particle_contacts;
+    planet_contact_cache planet_contacts;
 
     // Velocity of the deformed shape
     cgp::numarray<cgp::vec3> velocity;
@@ -29,11 +49,46 @@ struct shape_deformable_structure
     cgp::numarray<cgp::vec3> normal;
     // Connectivity of the mesh (used to recompute the per-vertex normals)
     cgp::numarray<cgp::uint3> connectivity;
+    // Triangles adjacent to each vertex in compressed rows: the triangles of
+    // the vertex k are vertex_triangles[vertex_triangle_offset[k] ..
+    // vertex_triangle_offset[k+1]-1]
+    std::vector<int> vertex_triangle_offset;
+    std::vector<int> vertex_triangles;
+    // Scratch storage of the (area weighted) normal of each triangle
+    cgp::numarray<cgp::vec3> triangle_normal;
     // The drawable element representing the deformed shape
     cgp::mesh_drawable drawable;
+    // Color of the shape when it is drawn by a rigid batch
+    cgp::vec3 color = { 1, 1, 1 };
+    // Colors of the vertices, for the batch renderer
+    cgp::numarray<cgp::vec3> vertex_color;
+    // Whether the shape can be drawn by the batch renderer (not the textured
+    // shapes, which keep their own drawable)
+    bool use_batch_renderer = true;
+    // Index of the rigid batch able to draw the shape from its rigid
+    // transform (-1 if none: the vertices are always uploaded)
+    int rigid_batch = -1;
+
+    // Physics level of detail of the shape for the current simulation step
+    // (see assign_physics_lod)
+    //  Distance class of the shape to the player and the camera
+    int physics_lod = 0;
+    //  Time step the shape is integrated with (0 if it is skipped)
+    float step_dt = 0.0f;
+    //  Number of collision handling steps the shape takes part in
+    int step_iterations = 0;
+    //  Whether the shape takes part in the current collision handling step
+    bool solving = true;
+    //  Number of steps skipped since the shape was last integrated
+    int skipped_steps = 0;
 
-    const BlackHole *got_black_holed = nullptr;
-    float dt_timer = 0;
+    // Acceleration due to the attraction of the other shapes (zero unless the
+    // mutual gravity is enabled), added to the one of the planets
+    cgp::vec3 mutual_gravity = { 0, 0, 0 };
+
+    // Black hole which captured the shape during the current simulation step
+    // (null handle if none)
+    slot_handle got_black_holed;
 
     // Initialize a reference structure from a mesh
     void initialize(cgp::mesh const &shape);
@@ -49,6 +104,14 @@ struct shape_deformable_structure
     // Returns the number of positions
     int size() const;
 
-    // Update the position and normals to the vbo of the drawable structure
+    // Recompute the per-vertex normals from the current positions, without
+    // any OpenGL call (can run in parallel on several shapes)
+    void update_normals();
+    // Send the positions and normals to the vbo of the drawable structure
+    void upload_drawable();
+    // Update the normals then upload them with the positions
     void update_drawable();
-};
\ No newline at end of file
+};
+
+// Storage of all the deformable shapes of the scene, referred by handles
+using deformable_store = SlotMap<shape_deformable_structure>;
\ No newline at end of file
@@ -0,0 +1,119 @@
+#include "deformable/rigid_batch.hpp"
+
+#include <cstddef>
+
+#include "simulation/simulation.hpp"
+
+using namespace cgp;
+
+void RigidBatch::initialize(const mesh &rest_mesh,
+                            const opengl_shader_structure &shader,
+                            const opengl_texture_image_structure &texture)
+{
+    _drawable.initialize_data_on_gpu(rest_mesh, shader, texture);
+
+    // Per-instance attributes (locations 4 to 8 of the instanced shader),
+    // advancing once per instance
+    glGenBuffers(1, &_instance_vbo);
+    glBindVertexArray(_drawable.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, _instance_vbo);
+    for (int k = 0; k < 5; ++k)
+    {
+        const GLuint location = 4 + k;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(
+            location, 3, GL_FLOAT, GL_FALSE, sizeof(instance_data),
+            reinterpret_cast<void *>(k * sizeof(vec3)));
+        glVertexAttribDivisor(location, 1);
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    _wireframe_drawable = _drawable;
+    _wireframe_drawable.material.color = { 0, 0, 1 };
+    _wireframe_drawable.material.phong = { 1, 0, 0, 1 };
+}
+
+bool RigidBatch::is_initialized() const
+{
+    return _instance_vbo != 0;
+}
+
+void RigidBatch::clear_instances()
+{
+    _instances.clear();
+}
+
+void RigidBatch::add_instance(const shape_deformable_structure &deformable)
+{
+    // Best rotation between the reference and the current positions, as in
+    // the shape matching
+    const vec3 com = center_of_mass(deformable.position);
+    mat3 T = mat3::build_zero();
+    for (int k = 0; k < deformable.size(); ++k)
+    {
+        T += tensor_product(deformable.position[k] - com,
+                            deformable.position_reference[k]
+                            - deformable.com_rest);
+    }
+    const mat3 R = polar_decomposition(T);
+
+    // p = R (p_reference - com_rest) + com
+    instance_data instance;
+    instance.translation = com - R * deformable.com_rest;
+    instance.rotation_x = R.col(0);
+    instance.rotation_y = R.col(1);
+    instance.rotation_z = R.col(2);
+    instance.color = deformable.color;
+    _instances.push_back(instance);
+}
+
+int RigidBatch::instance_count() const
+{
+    return _instances.size();
+}
+
+void RigidBatch::draw(const environment_structure &environment,
+                      bool wireframe)
+{
+    if (_instances.empty())
+    {
+        return;
+    }
+
+    const GLsizeiptr size = _instances.size() * sizeof(instance_data);
+    glBindBuffer(GL_ARRAY_BUFFER, _instance_vbo);
+    if (_gpu_capacity < int(_instances.size()))
+    {
+        // Grow the buffer with some margin for the next frames
+        _gpu_capacity = 2 * _instances.size();
+        glBufferData(GL_ARRAY_BUFFER, _gpu_capacity * sizeof(instance_data),
+                     nullptr, GL_DYNAMIC_DRAW);
+    }
+    glBufferSubData(GL_ARRAY_BUFFER, 0, size, _instances.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    cgp::draw(_drawable, environment, int(_instances.size()));
+
+    if (wireframe)
+    {
+        // Uniform color: the vertex and instance colors are replaced by
+        // constants
+        glBindVertexArray(_drawable.vao);
+        glDisableVertexAttribArray(2);
+        glDisableVertexAttribArray(8);
+        glBindVertexArray(0);
+        glVertexAttrib3f(2, 1.0f, 1.0f, 1.0f);
+        glVertexAttrib3f(8, 1.0f, 1.0f, 1.0f);
+        glEnable(GL_POLYGON_OFFSET_LINE);
+        glPolygonOffset(-1.0f, -1.0f);
+        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        cgp::draw(_wireframe_drawable, environment, int(_instances.size()));
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        glDisable(GL_POLYGON_OFFSET_LINE);
+        glBindVertexArray(_drawable.vao);
+        glEnableVertexAttribArray(2);
+        glEnableVertexAttribArray(8);
+        glBindVertexArray(0);
+    }
+}
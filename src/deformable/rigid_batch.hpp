@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+
+#include "cgp/cgp.hpp"
+#include "deformable/deformable.hpp"
+#include "environment.hpp"
+
+// Draws with a single instanced call all the rigid shapes sharing the same rest
+// mesh. Instead of their vertices, only the rotation, translation and color of
+// each shape are sent to the GPU at each frame.
+class RigidBatch
+{
+public:
+    // Upload the rest mesh (its vertex colors are multiplied by the color of
+    // each instance)
+    void initialize(const cgp::mesh &rest_mesh,
+                    const cgp::opengl_shader_structure &shader,
+                    const cgp::opengl_texture_image_structure &texture =
+                        cgp::mesh_drawable::default_texture);
+    bool is_initialized() const;
+
+    // Remove all the instances, before adding the ones of the current frame
+    void clear_instances();
+    // Add the shape as an instance, placed by the rigid transform that best
+    // matches its current positions to its reference positions
+    void add_instance(const shape_deformable_structure &deformable);
+    int instance_count() const;
+
+    // Send the instances to the GPU and draw them (and their wireframe if
+    // asked)
+    void draw(const environment_structure &environment, bool wireframe);
+
+private:
+    // Per-instance attributes, interleaved in a single buffer
+    struct instance_data
+    {
+        cgp::vec3 translation;
+        // Columns of the rotation
+        cgp::vec3 rotation_x;
+        cgp::vec3 rotation_y;
+        cgp::vec3 rotation_z;
+        cgp::vec3 color;
+    };
+
+    cgp::mesh_drawable _drawable;
+    // Same buffers, with the uniform material of the wireframes
+    cgp::mesh_drawable _wireframe_drawable;
+    // Buffer of the per-instance attributes, attached to the vao of the
+    // drawable
+    GLuint _instance_vbo = 0;
+    // Number of instances the buffer on the GPU can hold
+    int _gpu_capacity = 0;
+
+    // Instances of the current frame
+    std::vector<instance_data> _instances;
+};
@@ -0,0 +1,138 @@
+#include "deformable/sphere_tree.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace cgp;
+
+void SphereTree::build(const numarray<vec3> &reference,
+                       vec3 const &com_reference)
+{
+    _reference = &reference;
+    _com_reference = com_reference;
+    const int N_vertex = reference.size();
+    _vertices.resize(N_vertex);
+    float extent2 = 0.0f;
+    for (int k = 0; k < N_vertex; ++k)
+    {
+        _vertices[k] = k;
+        const vec3 d = reference[k] - com_reference;
+        extent2 = std::max(extent2, dot(d, d));
+    }
+    _extent = std::sqrt(extent2);
+    _nodes.clear();
+    if (N_vertex == 0)
+    {
+        return;
+    }
+
+    // Leaves of at least leaf_size / 2 vertices: less than N / 2 nodes
+    _nodes.reserve(N_vertex / 2 + 1);
+    _nodes.emplace_back();
+    _nodes[0].count = N_vertex;
+    split(0);
+
+    // The root box is the box of the whole reference shape
+    vec3 p_min = reference[0] - com_reference;
+    vec3 p_max = p_min;
+    for (const vec3 &p : reference)
+    {
+        for (int c = 0; c < 3; ++c)
+        {
+            p_min[c] = std::min(p_min[c], p[c] - com_reference[c]);
+            p_max[c] = std::max(p_max[c], p[c] - com_reference[c]);
+        }
+    }
+    _box_center = (p_min + p_max) / 2.0f;
+    _box_half_size = (p_max - p_min) / 2.0f;
+    // The reference is only read during the build
+    _reference = nullptr;
+}
+
+void SphereTree::split(int node_index)
+{
+    const numarray<vec3> &reference = *_reference;
+    const int first = _nodes[node_index].first;
+    const int count = _nodes[node_index].count;
+
+    // Bounding box of the vertices, whose center is the center of the sphere
+    vec3 p_min = reference[_vertices[first]];
+    vec3 p_max = p_min;
+    for (int k = first; k < first + count; ++k)
+    {
+        const vec3 &p = reference[_vertices[k]];
+        for (int c = 0; c < 3; ++c)
+        {
+            p_min[c] = std::min(p_min[c], p[c]);
+            p_max[c] = std::max(p_max[c], p[c]);
+        }
+    }
+    const vec3 middle = (p_min + p_max) / 2.0f;
+    float radius2 = 0.0f;
+    for (int k = first; k < first + count; ++k)
+    {
+        const vec3 d = reference[_vertices[k]] - middle;
+        radius2 = std::max(radius2, dot(d, d));
+    }
+    _nodes[node_index].center = middle - _com_reference;
+    _nodes[node_index].radius = std::sqrt(radius2);
+
+    if (count <= leaf_size)
+    {
+        return;
+    }
+
+    // Median along the largest extent
+    const vec3 extent = p_max - p_min;
+    int axis = 0;
+    if (extent.y > extent[axis])
+        axis = 1;
+    if (extent.z > extent[axis])
+        axis = 2;
+    int *begin = _vertices.data() + first;
+    const int half = count / 2;
+    std::nth_element(begin, begin + half, begin + count, [&](int a, int b) {
+        return reference[a][axis] < reference[b][axis];
+    });
+
+    const int child = _nodes.size();
+    _nodes[node_index].first_child = child;
+    _nodes.emplace_back();
+    _nodes.emplace_back();
+    _nodes[child].first = first;
+    _nodes[child].count = half;
+    _nodes[child + 1].first = first + half;
+    _nodes[child + 1].count = count - half;
+    split(child);
+    split(child + 1);
+}
+
+bool SphereTree::empty() const
+{
+    return _nodes.empty();
+}
+
+const std::vector<SphereTree::node> &SphereTree::nodes() const
+{
+    return _nodes;
+}
+
+const std::vector<int> &SphereTree::vertices() const
+{
+    return _vertices;
+}
+
+vec3 const &SphereTree::box_center() const
+{
+    return _box_center;
+}
+
+vec3 const &SphereTree::box_half_size() const
+{
+    return _box_half_size;
+}
+
+float SphereTree::extent() const
+{
+    return _extent;
+}
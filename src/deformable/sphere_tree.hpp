@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+
+#include "cgp/cgp.hpp"
+
+// Hierarchy of bounding spheres over the reference shape of a deformable,
+// built once at its initialization. The spheres are expressed relative to the
+// center of mass of the reference shape, so that a rotation and a center
+// place the whole tree on the deformed shape without visiting its nodes (see
+// sphere_tree_placement).
+// The vertices are split at the median of the largest extent of their
+// bounding box: the tree is balanced, of depth log2(N / leaf_size).
+class SphereTree
+{
+public:
+    // Vertices tested directly instead of split further
+    static constexpr int leaf_size = 8;
+
+    struct node
+    {
+        // Center of the sphere (relative to the reference center of mass)
+        // and its radius
+        cgp::vec3 center;
+        float radius = 0.0f;
+        // Vertices of the node: vertices()[first .. first + count - 1]
+        int first = 0;
+        int count = 0;
+        // Children at first_child and first_child + 1 (0 for a leaf)
+        int first_child = 0;
+    };
+
+    // Build the tree over the reference positions, of the given center of
+    // mass
+    void build(const cgp::numarray<cgp::vec3> &reference,
+               cgp::vec3 const &com_reference);
+
+    bool empty() const;
+    // Nodes, the root first
+    const std::vector<node> &nodes() const;
+    // Vertex indices sorted by node
+    const std::vector<int> &vertices() const;
+    // Bounding box of the reference shape, relative to its center of mass
+    cgp::vec3 const &box_center() const;
+    cgp::vec3 const &box_half_size() const;
+    // Largest distance of a vertex to the center of mass
+    float extent() const;
+
+private:
+    // Compute the sphere of the node, and split its vertices among two
+    // children if it has too many
+    void split(int node_index);
+
+    const cgp::numarray<cgp::vec3> *_reference = nullptr;
+    cgp::vec3 _com_reference;
+    std::vector<node> _nodes;
+    std::vector<int> _vertices;
+    cgp::vec3 _box_center;
+    cgp::vec3 _box_half_size;
+    float _extent = 0.0f;
+};
+
+// Placement of a sphere tree on the deformed shape: each vertex k lies within
+// margin of center + rotation * (p_reference[k] - com_reference). The node
+// spheres, moved the same way and enlarged by the margin, bound the vertices
+// of the deformed shape.
+struct sphere_tree_placement
+{
+    cgp::mat3 rotation = cgp::mat3::build_identity();
+    cgp::vec3 center;
+    float margin = 0.0f;
+    // Whether the placement holds for the current predicted positions
+    bool valid = false;
+};
@@ -1,14 +1,25 @@
 
 
 #include <chrono>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <thread>
 
 #include "cgp/cgp.hpp" // Give access to the complete CGP library
 #include "environment.hpp" // The general scene environment + project variable
+#include "profiling/profiler.hpp" // Per-phase timings of the frame
+#include "profiling/trace.hpp" // Chrome trace of the frame stages
+#include "timing/frame_pacer.hpp" // Sleep and spin frame rate limiter
 
 // Custom scene of this code
 #include "scene.hpp"
+// Headless runs of the simulation (--benchmark) and of its kernels
+// (--microbenchmark)
+#include "benchmark/kernel_benchmark.hpp"
+#include "benchmark/simulation_benchmark.hpp"
+// Regression of the particle positions against golden files (--golden-*)
+#include "validation/golden_state.hpp"
 
 // *************************** //
 // Custom Scene defined in "scene.hpp"
@@ -22,23 +33,90 @@ scene_structure scene;
 // Start of the program
 // *************************** //
 
-window_structure standard_window_initialization();
+window_structure standard_window_initialization(bool visible = true);
 void initialize_default_shaders();
 void animation_loop();
 void display_gui_default();
 
 timer_fps fps_record;
+FramePacer frame_pacer;
 
-int main(int, char *argv[])
+int main(int argc, char *argv[])
 {
     std::cout << "Run " << argv[0] << std::endl;
+    // The kernels are benchmarked without scene
+    const bool has_scene = argc >= 2 && std::strncmp(argv[1], "--", 2) != 0;
+
+    // Headless benchmark of the simulation or of its kernels: no display,
+    // the timings are written as JSON
+    bool benchmark = false;
+    bool microbenchmark = false;
+    benchmark_parameter benchmark_param;
+    kernel_benchmark_parameter kernel_param;
+    std::string benchmark_output;
+    std::string benchmark_baseline;
+    // Golden state of the scene to record, or to compare with
+    std::string golden_record;
+    std::string golden_compare;
+    int golden_steps = 300;
+    float golden_tolerance = 1e-3f;
+    // Backend of the solver passes, instead of the default one
+    std::string backend_name;
+    for (int k = has_scene ? 2 : 1; k < argc; ++k)
+    {
+        if (std::strcmp(argv[k], "--benchmark") == 0)
+            benchmark = true;
+        else if (std::strcmp(argv[k], "--microbenchmark") == 0)
+            microbenchmark = true;
+        else if (std::strcmp(argv[k], "--steps") == 0 && k + 1 < argc)
+            benchmark_param.steps = golden_steps = std::atoi(argv[++k]);
+        else if (std::strcmp(argv[k], "--warmup") == 0 && k + 1 < argc)
+            benchmark_param.warmup_steps = std::atoi(argv[++k]);
+        else if (std::strcmp(argv[k], "--repetitions") == 0 && k + 1 < argc)
+            kernel_param.repetitions = std::atoi(argv[++k]);
+        else if (std::strcmp(argv[k], "--seed") == 0 && k + 1 < argc)
+            kernel_param.seed = std::atoi(argv[++k]);
+        else if (std::strcmp(argv[k], "--output") == 0 && k + 1 < argc)
+            benchmark_output = argv[++k];
+        else if (std::strcmp(argv[k], "--baseline") == 0 && k + 1 < argc)
+            benchmark_baseline = argv[++k];
+        else if (std::strcmp(argv[k], "--golden-record") == 0 && k + 1 < argc)
+            golden_record = argv[++k];
+        else if (std::strcmp(argv[k], "--golden-compare") == 0
+                 && k + 1 < argc)
+            golden_compare = argv[++k];
+        else if (std::strcmp(argv[k], "--tolerance") == 0 && k + 1 < argc)
+            golden_tolerance = std::atof(argv[++k]);
+        else if (std::strcmp(argv[k], "--backend") == 0 && k + 1 < argc)
+            backend_name = argv[++k];
+    }
+    const bool golden = !golden_record.empty() || !golden_compare.empty();
+
+    if (!has_scene && !microbenchmark)
+    {
+        std::cerr << "Usage: " << argv[0]
+                  << " <scene number | scene file in config/scenes/>"
+                  << " [--benchmark [--steps N] [--warmup N]"
+                  << " [--output results.json]]"
+                  << " [--golden-record states.golden [--steps N]]"
+                  << " [--golden-compare states.golden [--tolerance T]]"
+                  << " [--backend reference|simd|threaded|specialized]\n"
+                  << "       " << argv[0]
+                  << " --microbenchmark [--repetitions N] [--seed N]"
+                  << " [--output kernels.json] [--baseline kernels.json]"
+                  << std::endl;
+        return 1;
+    }
 
     // ************************ //
     //     INITIALISATION
     // ************************ //
 
-    // Standard Initialization of an OpenGL ready window
-    scene.window = standard_window_initialization();
+    // Standard Initialization of an OpenGL ready window (hidden for the
+    // benchmarks: the shapes still need an OpenGL context to be created)
+    scene.window =
+        standard_window_initialization(!benchmark && !microbenchmark
+                                       && !golden);
 
     // Initialize default path for assets
     project::path = cgp::project_path_find(argv[0], "shaders/");
@@ -46,14 +124,124 @@ int main(int, char *argv[])
     // Initialize default shaders
     initialize_default_shaders();
 
+    if (microbenchmark)
+    {
+        std::cout << "Benchmark of the simulation kernels ..." << std::endl;
+        const std::vector<kernel_benchmark_result> results =
+            run_kernel_benchmarks(kernel_param);
+        print_kernel_benchmark_summary(std::cout, results, benchmark_baseline);
+        if (!benchmark_output.empty())
+        {
+            std::ofstream file(benchmark_output);
+            write_kernel_benchmark_json(file, results, kernel_param);
+        }
+
+        cgp::imgui_cleanup();
+        glfwDestroyWindow(scene.window.glfw_window);
+        glfwTerminate();
+        return 0;
+    }
+
     // Custom scene initialization
     std::cout << "Initialize data of the scene ..." << std::endl;
-    std::ostringstream scene_oss;
-    scene_oss << "scene_" << std::setw(2) << std::setfill('0') << argv[1] << ".yaml";
-    const std::string scene_filename = scene_oss.str();
+    // The scene is given by its number, or by its file (generated scenes)
+    std::string scene_filename = argv[1];
+    if (scene_filename.find(".yaml") == std::string::npos)
+    {
+        std::ostringstream scene_oss;
+        scene_oss << "scene_" << std::setw(2) << std::setfill('0') << argv[1] << ".yaml";
+        scene_filename = scene_oss.str();
+    }
     scene.initialize(scene_filename);
+    if (!backend_name.empty()
+        && !parse_solver_backend(backend_name, scene.param.backend))
+    {
+        std::cerr << "Unknown solver backend " << backend_name << std::endl;
+        return 1;
+    }
     std::cout << "Initialization finished\n" << std::endl;
 
+    if (benchmark)
+    {
+        std::cout << "Benchmark of " << scene_filename << " ..." << std::endl;
+        const benchmark_result result =
+            run_simulation_benchmark(scene, scene_filename, benchmark_param);
+        write_benchmark_json(std::cout, result);
+        if (!benchmark_output.empty())
+        {
+            // Appended: a file collects the results of several scenes
+            std::ofstream file(benchmark_output, std::ios::app);
+            write_benchmark_json(file, result);
+        }
+
+        cgp::imgui_cleanup();
+        glfwDestroyWindow(scene.window.glfw_window);
+        glfwTerminate();
+        return 0;
+    }
+
+    if (golden)
+    {
+        // The comparison runs as many steps as the recording
+        golden_state expected;
+        if (!golden_compare.empty())
+        {
+            if (!expected.load(golden_compare))
+            {
+                std::cerr << "Could not read " << golden_compare << std::endl;
+                return 1;
+            }
+            golden_steps = expected.steps;
+        }
+
+        std::cout << "Run " << golden_steps << " steps of " << scene_filename
+                  << " ..." << std::endl;
+        for (int step = 0; step < golden_steps; ++step)
+        {
+            scene.simulate_frame();
+        }
+        const golden_state state =
+            golden_state::from_deformables(scene.deformables, golden_steps);
+
+        int exit_code = 0;
+        if (!golden_record.empty())
+        {
+            if (state.save(golden_record))
+                std::cout << "Golden state written to " << golden_record
+                          << std::endl;
+            else
+            {
+                std::cerr << "Could not write " << golden_record << std::endl;
+                exit_code = 1;
+            }
+        }
+        else
+        {
+            const golden_comparison comparison =
+                compare_golden_state(expected, state);
+            const bool passed = comparison.passed(golden_tolerance);
+            if (!comparison.same_layout)
+                std::cout << "Golden comparison: the shapes differ ("
+                          << state.positions.size() << " shapes instead of "
+                          << expected.positions.size() << ")";
+            else
+                std::cout << "Golden comparison: " << comparison.vertices
+                          << " vertices, max deviation "
+                          << comparison.max_deviation << " (shape "
+                          << comparison.max_shape << ", vertex "
+                          << comparison.max_vertex << "), rms deviation "
+                          << comparison.rms_deviation;
+            std::cout << ", tolerance " << golden_tolerance << ": "
+                      << (passed ? "PASSED" : "FAILED") << std::endl;
+            exit_code = passed ? 0 : 2;
+        }
+
+        cgp::imgui_cleanup();
+        glfwDestroyWindow(scene.window.glfw_window);
+        glfwTerminate();
+        return exit_code;
+    }
+
     // ************************ //
     //     Animation Loop
     // ************************ //
@@ -66,7 +254,6 @@ int main(int, char *argv[])
     //  mode with GLFW, than when we compile with emscripten to output the
     //  result in a webpage.)
 #ifndef __EMSCRIPTEN__
-    double lasttime = glfwGetTime();
     // Default mode to run the animation/display loop with GLFW in C++
     while (!glfwWindowShouldClose(scene.window.glfw_window))
     {
@@ -76,10 +263,12 @@ int main(int, char *argv[])
         // FPS limitation
         if (project::fps_limiting)
         {
-            while (glfwGetTime() < lasttime + 1.0 / project::fps_max)
-            {
-            }
-            lasttime = glfwGetTime();
+            trace_scope trace("frame_pacing");
+            frame_pacer.wait_next_frame(project::fps_max);
+        }
+        else
+        {
+            frame_pacer.reset();
         }
     }
 #else
@@ -99,6 +288,8 @@ int main(int, char *argv[])
 
 void animation_loop()
 {
+    trace_scope frame_trace("frame");
+
     emscripten_update_window_size(
         scene.window.width,
         scene.window.height); // update window size in case of use of emscripten
@@ -130,20 +321,41 @@ void animation_loop()
     scene.inputs.time_interval = time_interval;
 
     // Display the ImGUI interface (button, sliders, etc)
-    display_gui_default();
-    scene.display_gui();
+    {
+        trace_scope trace("display_gui");
+        display_gui_default();
+        scene.display_gui();
+    }
 
     // Handle camera behavior in standard frame
-    scene.idle_frame();
+    {
+        trace_scope trace("idle_frame");
+        scene.idle_frame();
+    }
 
     // Call the display of the scene
-    scene.display_frame();
+    {
+        trace_scope trace("display_frame");
+        scene.display_frame();
+    }
 
     // End of ImGui display and handle GLFW events
     ImGui::End();
-    imgui_render_frame(scene.window.glfw_window);
-    glfwSwapBuffers(scene.window.glfw_window);
-    glfwPollEvents();
+    {
+        trace_scope trace("imgui_render_frame");
+        imgui_render_frame(scene.window.glfw_window);
+    }
+    {
+        trace_scope trace("swap_buffers");
+        glfwSwapBuffers(scene.window.glfw_window);
+    }
+    {
+        trace_scope trace("poll_events");
+        glfwPollEvents();
+    }
+
+    // Push the timings of this frame to the profiler statistics
+    profiler.end_frame();
 }
 
 void initialize_default_shaders()
@@ -152,6 +364,8 @@ void initialize_default_shaders()
     //  By default, it should be "shaders/"
     std::string default_path_shaders = project::path + "shaders/";
 
+    trace_scope trace("load_shaders");
+
     // Set standard mesh shader for mesh_drawable
     mesh_drawable::default_shader.load(
         default_path_shaders + "mesh/mesh.vert.glsl",
@@ -181,13 +395,14 @@ void mouse_click_callback(GLFWwindow *window, int button, int action, int mods);
 void keyboard_callback(GLFWwindow *window, int key, int, int action, int mods);
 
 // Standard initialization procedure
-window_structure standard_window_initialization()
+window_structure standard_window_initialization(bool visible)
 {
     // Initialize GLFW and create window
     // ***************************************************** //
 
     // First initialize GLFW
     scene.window.initialize_glfw();
+    glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
 
     // Compute initial window width and height
     int window_width = int(project::initial_window_size_width);
@@ -313,10 +528,17 @@ void keyboard_callback(GLFWwindow *window, int key, int scancode, int action,
             std::cout << "  View matrix:" << std::endl;
             std::cout << str_pretty(camera_model.matrix_view()) << std::endl;
         }
+        // Press 'T' to start/stop the recording of a Chrome trace
+        if (key == GLFW_KEY_T && action == GLFW_PRESS
+            && scene.inputs.keyboard.shift)
+        {
+            trace_recorder.toggle();
+        }
 
         if (key == GLFW_KEY_K && action == GLFW_PRESS)
         {
             scene.deformables.clear();
+            scene.captured_bodies.clear();
             std::cout << "Cleared deformables." << std::endl;
         }
     }
@@ -356,6 +578,19 @@ void display_gui_default()
         if (project::fps_limiting)
         {
             ImGui::SliderFloat("FPS limit", &project::fps_max, 10, 250);
+            // Pacing of the last frames (sleep, then spin for the margin)
+            const rolling_statistics &interval = frame_pacer.frame_interval();
+            const rolling_statistics &jitter = frame_pacer.jitter();
+            ImGui::Text("Frame interval: %.2f ms (p99 %.2f ms)",
+                        interval.average(), interval.percentile(0.99f));
+            ImGui::Text("Jitter: %.3f ms (max %.3f ms)", jitter.average(),
+                        jitter.maximum());
+            ImGui::Text("Missed deadlines: %d recent, %lld total",
+                        frame_pacer.recent_missed_deadlines(),
+                        frame_pacer.missed_deadlines());
+            ImGui::Text("Spin: %.2f ms per frame (margin %.2f ms)",
+                        frame_pacer.spin_time().average(),
+                        frame_pacer.spin_margin());
         }
 #endif
         // vsync is the default synchronization of frame refresh with the screen
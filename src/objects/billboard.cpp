@@ -17,8 +17,8 @@ void Billboard::set_texture(cgp::opengl_texture_image_structure *texture)
 
 void Billboard::update_mesh_from_camera(const cgp::camera_orbit_euler& camera)
 {
-    _drawable.clear();
-
+    // No OpenGL call: can run on any thread, the upload is done by
+    // update_drawable
     cgp::vec3 right = camera.right();
     cgp::vec3 up = camera.up();
 
@@ -29,7 +29,9 @@ void Billboard::update_mesh_from_camera(const cgp::camera_orbit_euler& camera)
     cgp::vec3 p01 = _origin + d * (-right + up);
 
     _mesh = cgp::mesh_primitive_quadrangle(p00, p10, p11, p01);
-    initialize_data_on_gpu();
+    position = _mesh.position;
+    connectivity = _mesh.connectivity;
+    normal_per_vertex(position, connectivity, normal);
 }
 
 cgp::mesh Billboard::get_mesh()
@@ -58,8 +60,13 @@ void Billboard::initialize_data_on_gpu()
 
 cgp::mesh_drawable Billboard::update_drawable()
 {
+    // The quad always has the same connectivity: the buffers are created
+    // once, then only the vertices are updated
+    if (_drawable.vao == 0)
+    {
+        initialize_data_on_gpu();
+    }
     _drawable.vbo_position.update(position);
-    normal_per_vertex(position, connectivity, normal);
     _drawable.vbo_normal.update(normal);
     return _drawable;
 }
\ No newline at end of file
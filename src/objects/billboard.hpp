@@ -9,10 +9,12 @@ public:
     Billboard(cgp::vec3 origin, float size, cgp::camera_orbit_euler camera);
 
     void set_texture(cgp::opengl_texture_image_structure *texture);
+    // Turn the quad toward the camera (no OpenGL call)
     void update_mesh_from_camera(const cgp::camera_orbit_euler& camera);
     cgp::mesh get_mesh();
 
     void initialize_data_on_gpu();
+    // Send the quad to the GPU (main thread)
     cgp::mesh_drawable update_drawable();
 
 
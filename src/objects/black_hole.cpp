@@ -10,6 +10,11 @@ BlackHole::BlackHole(float radius, float attraction_radius, cgp::vec3 center)
       , _center(center)
 {
     _billboard.set_texture(black_hole_global_texture);
+
+    // The black holes don't move: their bounding box is computed once
+    _bounding_box.p_min = center;
+    _bounding_box.p_max = center;
+    _bounding_box.extends(2 * radius);
 }
 
 void BlackHole::update_mesh_from_camera(cgp::camera_orbit_euler camera)
@@ -35,4 +40,9 @@ float BlackHole::get_attraction_radius() const
 const cgp::vec3 &BlackHole::get_center() const
 {
     return _center;
+}
+
+const cgp::bounding_box &BlackHole::get_bounding_box() const
+{
+    return _bounding_box;
 }
\ No newline at end of file
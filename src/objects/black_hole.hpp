@@ -15,12 +15,15 @@ public:
     float get_radius() const;
     float get_attraction_radius() const;
     const cgp::vec3 &get_center() const;
+    // Bounding box of the black hole, used to discard far away deformables
+    const cgp::bounding_box &get_bounding_box() const;
 
 private:
     Billboard _billboard;
     float _radius;
     float _attraction_radius;
     cgp::vec3 _center;
+    cgp::bounding_box _bounding_box;
 };
 
 static std::string black_hole_global_texture_path =
@@ -0,0 +1,54 @@
+#include "instanced_spheres.hpp"
+
+using namespace cgp;
+
+void InstancedSpheres::initialize(const mesh &sphere_mesh,
+                                  const opengl_shader_structure &shader)
+{
+    drawable.initialize_data_on_gpu(sphere_mesh, shader);
+
+    // Center of each sphere (location 4 of the instanced shader), advancing
+    // once per instance
+    glGenBuffers(1, &_instance_vbo);
+    glBindVertexArray(drawable.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, _instance_vbo);
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), nullptr);
+    glVertexAttribDivisor(4, 1);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstancedSpheres::clear()
+{
+    _centers.clear();
+}
+
+void InstancedSpheres::add(const numarray<vec3> &centers)
+{
+    _centers.insert(_centers.end(), centers.begin(), centers.end());
+}
+
+void InstancedSpheres::draw(const environment_structure &environment,
+                            float radius)
+{
+    if (_centers.empty())
+    {
+        return;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, _instance_vbo);
+    if (_gpu_capacity < int(_centers.size()))
+    {
+        // Grow the buffer with some margin for the next frames
+        _gpu_capacity = 2 * _centers.size();
+        glBufferData(GL_ARRAY_BUFFER, _gpu_capacity * sizeof(vec3), nullptr,
+                     GL_DYNAMIC_DRAW);
+    }
+    glBufferSubData(GL_ARRAY_BUFFER, 0, _centers.size() * sizeof(vec3),
+                    _centers.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    drawable.model.scaling = radius;
+    cgp::draw(drawable, environment, int(_centers.size()));
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vector>
+
+#include "cgp/cgp.hpp"
+#include "environment.hpp"
+
+// Draws many spheres of the same radius with a single instanced call, only
+// their centers being sent to the GPU (used to display the collision spheres
+// of all the particles).
+class InstancedSpheres
+{
+public:
+    void initialize(const cgp::mesh &sphere_mesh,
+                    const cgp::opengl_shader_structure &shader);
+
+    // Remove all the spheres, before adding the ones of the current frame
+    void clear();
+    void add(const cgp::numarray<cgp::vec3> &centers);
+
+    // Send the centers to the GPU and draw the spheres
+    void draw(const environment_structure &environment, float radius);
+
+    cgp::mesh_drawable drawable;
+
+private:
+    // Buffer of the centers, attached to the vao of the drawable
+    GLuint _instance_vbo = 0;
+    // Number of centers the buffer on the GPU can hold
+    int _gpu_capacity = 0;
+    std::vector<cgp::vec3> _centers;
+};
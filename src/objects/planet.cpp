@@ -1,5 +1,7 @@
 #include "planet.hpp"
 
+#include <algorithm>
+
 Planet::Planet(float radius, float attraction_radius, cgp::vec3 center,
                int sampling_horizontal, int sampling_vertical)
     : _mesh(cgp::mesh_primitive_sphere(radius, center, sampling_horizontal,
@@ -11,12 +13,46 @@ Planet::Planet(float radius, float attraction_radius, cgp::vec3 center,
     , _sampling_vertical(sampling_vertical)
 {
     _mesh.centered();
+
+    // The planets don't move: their bounding box is computed once
+    _bounding_box.initialize(_mesh.position);
+    _bounding_box.p_min += center;
+    _bounding_box.p_max += center;
+    _bounding_box.extends(2 * radius);
+
     _shape.initialize(_mesh);
     const cgp::vec3 velocity({ 0.0, 0.0, 0.0 });
     const cgp::vec3 angular_velocity({ 0.0, 0.0, 0.0 });
     _shape.set_position_and_velocity(center, velocity, angular_velocity);
         _shape.drawable.texture.load_and_initialize_texture_2d_on_gpu(
             "assets/textures/earth-texture.png");
+
+    // The planets don't deform: the coarser levels are uploaded once
+    for (int level = 1; level < lod_count; ++level)
+    {
+        const int horizontal = std::max(sampling_horizontal >> level, 4);
+        const int vertical = std::max(sampling_vertical >> level, 4);
+        cgp::mesh_drawable &drawable = _lod_drawables[level - 1];
+        drawable.initialize_data_on_gpu(
+            cgp::mesh_primitive_sphere(radius, { 0, 0, 0 }, horizontal,
+                                       vertical),
+            cgp::mesh_drawable::default_shader, _shape.drawable.texture);
+        drawable.model.translation = center;
+    }
+}
+
+int Planet::select_lod(float projected_radius)
+{
+    if (projected_radius > 0.25f)
+        return 0;
+    if (projected_radius > 0.06f)
+        return 1;
+    return 2;
+}
+
+const cgp::mesh_drawable &Planet::get_lod_drawable(int level) const
+{
+    return level == 0 ? _shape.drawable : _lod_drawables[level - 1];
 }
 
 const cgp::mesh &Planet::get_mesh() const
@@ -49,6 +85,11 @@ int Planet::get_sampling_vertical() const
     return _sampling_vertical;
 }
 
+const cgp::bounding_box &Planet::get_bounding_box() const
+{
+    return _bounding_box;
+}
+
 bool Planet::should_attract_deformable(const shape_deformable_structure &deformable) const
 {
     cgp::vec3 deformable_to_planet = get_center() - deformable.com;
@@ -18,6 +18,17 @@ public:
     const cgp::vec3 &get_center() const;
     int get_sampling_horizontal() const;
     int get_sampling_vertical() const;
+    // Bounding box of the planet, used to discard far away deformables
+    const cgp::bounding_box &get_bounding_box() const;
+
+    // Number of levels of detail of the planet mesh, the level 0 being the
+    // mesh of the shape and each next level halving its sampling
+    static constexpr int lod_count = 3;
+    // Level of detail to display for a radius projected on screen (fraction
+    // of the half height of the screen)
+    static int select_lod(float projected_radius);
+    // Drawable of the given level of detail
+    const cgp::mesh_drawable &get_lod_drawable(int level) const;
 
     bool should_attract_deformable(const shape_deformable_structure &deformable) const;
     const shape_deformable_structure &get_shape() const;
@@ -30,6 +41,10 @@ private:
     cgp::vec3 _center;
     int _sampling_horizontal;
     int _sampling_vertical;
+    cgp::bounding_box _bounding_box;
 
     shape_deformable_structure _shape;
+    // Coarser meshes of the levels 1 to lod_count-1, placed by their model
+    // transform
+    cgp::mesh_drawable _lod_drawables[lod_count - 1];
 };
\ No newline at end of file
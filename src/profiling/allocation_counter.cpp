@@ -0,0 +1,146 @@
+#include "profiling/allocation_counter.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Replace the global operator new/delete to count the heap allocations.
+// The counter is atomic as allocations can happen on any thread, and each
+// thread also counts its own allocations.
+
+namespace
+{
+    std::atomic<long long> allocation_count{ 0 };
+    thread_local long long thread_allocation_count = 0;
+
+    void count_allocation()
+    {
+        allocation_count.fetch_add(1, std::memory_order_relaxed);
+        ++thread_allocation_count;
+    }
+
+    void *counted_allocation(std::size_t size)
+    {
+        count_allocation();
+        if (void *memory = std::malloc(size == 0 ? 1 : size))
+            return memory;
+        throw std::bad_alloc();
+    }
+
+    void *counted_aligned_allocation(std::size_t size, std::size_t alignment)
+    {
+        count_allocation();
+        // aligned_alloc requires the size to be a multiple of the alignment
+        const std::size_t rounded = (size + alignment - 1) / alignment
+            * alignment;
+#if defined(_MSC_VER)
+        if (void *memory = _aligned_malloc(rounded, alignment))
+            return memory;
+#else
+        if (void *memory = std::aligned_alloc(alignment, rounded))
+            return memory;
+#endif
+        throw std::bad_alloc();
+    }
+
+    void aligned_free(void *memory)
+    {
+#if defined(_MSC_VER)
+        _aligned_free(memory);
+#else
+        std::free(memory);
+#endif
+    }
+} // namespace
+
+long long heap_allocation_count()
+{
+    return allocation_count.load(std::memory_order_relaxed);
+}
+
+long long thread_heap_allocation_count()
+{
+    return thread_allocation_count;
+}
+
+void *operator new(std::size_t size)
+{
+    return counted_allocation(size);
+}
+
+void *operator new[](std::size_t size)
+{
+    return counted_allocation(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    count_allocation();
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    count_allocation();
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+    return counted_aligned_allocation(size, std::size_t(alignment));
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return counted_aligned_allocation(size, std::size_t(alignment));
+}
+
+void operator delete(void *memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void *memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void *memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void *memory, const std::nothrow_t &) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void *memory, const std::nothrow_t &) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::align_val_t) noexcept
+{
+    aligned_free(memory);
+}
+
+void operator delete[](void *memory, std::align_val_t) noexcept
+{
+    aligned_free(memory);
+}
+
+void operator delete(void *memory, std::size_t, std::align_val_t) noexcept
+{
+    aligned_free(memory);
+}
+
+void operator delete[](void *memory, std::size_t, std::align_val_t) noexcept
+{
+    aligned_free(memory);
+}
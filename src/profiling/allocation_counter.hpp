@@ -0,0 +1,9 @@
+#pragma once
+
+// Number of heap allocations (calls to operator new) done by the program
+// since its start. Used to check that the hot loops don't allocate.
+long long heap_allocation_count();
+
+// Number of heap allocations done by the calling thread since its start (not
+// disturbed by the tasks running at the same time on other threads)
+long long thread_heap_allocation_count();
@@ -0,0 +1,32 @@
+#include "profiling/memory_usage.hpp"
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi")
+#elif defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+long long peak_resident_memory()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return (long long)counters.PeakWorkingSetSize;
+    return -1;
+#elif defined(__unix__) || defined(__APPLE__)
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return -1;
+#if defined(__APPLE__)
+    // In bytes on macOS
+    return (long long)usage.ru_maxrss;
+#else
+    // In kilobytes on Linux
+    return (long long)usage.ru_maxrss * 1024;
+#endif
+#else
+    return -1;
+#endif
+}
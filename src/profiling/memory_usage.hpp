@@ -0,0 +1,5 @@
+#pragma once
+
+// Largest resident memory of the process since its start, in bytes (-1 if it
+// can't be measured on this platform)
+long long peak_resident_memory();
@@ -0,0 +1,218 @@
+#include "profiling/profiler.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+#include "cgp/cgp.hpp"
+
+profiler_structure profiler;
+
+void rolling_statistics::add_sample(float value)
+{
+    samples[next] = value;
+    next = (next + 1) % window_size;
+    count = std::min(count + 1, window_size);
+}
+
+float rolling_statistics::average() const
+{
+    if (count == 0)
+        return 0.0f;
+
+    double sum = 0.0;
+    for (int k = 0; k < count; ++k)
+        sum += samples[k];
+    return float(sum / count);
+}
+
+float rolling_statistics::maximum() const
+{
+    float result = 0.0f;
+    for (int k = 0; k < count; ++k)
+        result = std::max(result, samples[k]);
+    return result;
+}
+
+float rolling_statistics::percentile(float ratio) const
+{
+    if (count == 0)
+        return 0.0f;
+
+    // Work on a copy on the stack: the window is small and this avoids any
+    // allocation during the display
+    std::array<float, window_size> sorted = samples;
+    const int index = std::clamp(int(ratio * (count - 1) + 0.5f), 0,
+                                 count - 1);
+    std::nth_element(sorted.begin(), sorted.begin() + index,
+                     sorted.begin() + count);
+    return sorted[index];
+}
+
+void profiler_structure::add_time(profiler_phase_enum phase,
+                                  double milliseconds)
+{
+    // No fetch_add for floating point atomics before C++20
+    std::atomic<double> &time = frame_time[phase];
+    double current = time.load(std::memory_order_relaxed);
+    while (!time.compare_exchange_weak(current, current + milliseconds,
+                                       std::memory_order_relaxed))
+    {
+    }
+}
+
+void profiler_structure::add_count(profiler_counter_enum counter,
+                                   long long value)
+{
+    if (enabled)
+        frame_counter[counter].fetch_add(value, std::memory_order_relaxed);
+}
+
+void profiler_structure::end_frame()
+{
+    if (!enabled)
+        return;
+
+    for (int phase = 0; phase < phase_count; ++phase)
+    {
+        time_statistics[phase].add_sample(
+            float(frame_time[phase].exchange(0.0)));
+    }
+    for (int counter = 0; counter < counter_count; ++counter)
+    {
+        counter_statistics[counter].add_sample(
+            float(frame_counter[counter].exchange(0)));
+    }
+}
+
+void profiler_structure::display_gui()
+{
+    ImGui::Checkbox("Enable profiler", &enabled);
+
+    ImGui::Text("%-22s %8s %8s %8s %8s", "Phase (ms)", "avg", "p50", "p95",
+                "p99");
+    for (int phase = 0; phase < phase_count; ++phase)
+    {
+        const rolling_statistics &statistics = time_statistics[phase];
+        ImGui::Text("%-22s %8.3f %8.3f %8.3f %8.3f",
+                    phase_name(profiler_phase_enum(phase)),
+                    statistics.average(), statistics.percentile(0.5f),
+                    statistics.percentile(0.95f),
+                    statistics.percentile(0.99f));
+    }
+
+    ImGui::Spacing();
+    ImGui::Text("%-22s %10s %10s", "Counter (per frame)", "avg", "max");
+    for (int counter = 0; counter < counter_count; ++counter)
+    {
+        const rolling_statistics &statistics = counter_statistics[counter];
+        ImGui::Text("%-22s %10.0f %10.0f",
+                    counter_name(profiler_counter_enum(counter)),
+                    statistics.average(), statistics.maximum());
+    }
+
+    if (ImGui::Button("Export CSV"))
+    {
+        const std::string filename = "profiler.csv";
+        if (export_csv(filename))
+            std::cout << "Exported profiler statistics to " << filename
+                      << std::endl;
+        else
+            std::cerr << "Could not write " << filename << std::endl;
+    }
+}
+
+bool profiler_structure::export_csv(const std::string &filename) const
+{
+    std::ofstream file(filename);
+    if (!file)
+        return false;
+
+    file << "name,unit,average,p50,p95,p99,max\n";
+    for (int phase = 0; phase < phase_count; ++phase)
+    {
+        const rolling_statistics &statistics = time_statistics[phase];
+        file << phase_name(profiler_phase_enum(phase)) << ",ms,"
+             << statistics.average() << "," << statistics.percentile(0.5f)
+             << "," << statistics.percentile(0.95f) << ","
+             << statistics.percentile(0.99f) << "," << statistics.maximum()
+             << "\n";
+    }
+    for (int counter = 0; counter < counter_count; ++counter)
+    {
+        const rolling_statistics &statistics = counter_statistics[counter];
+        file << counter_name(profiler_counter_enum(counter)) << ",count,"
+             << statistics.average() << "," << statistics.percentile(0.5f)
+             << "," << statistics.percentile(0.95f) << ","
+             << statistics.percentile(0.99f) << "," << statistics.maximum()
+             << "\n";
+    }
+
+    return true;
+}
+
+const char *profiler_structure::phase_name(profiler_phase_enum phase)
+{
+    switch (phase)
+    {
+    case phase_simulation_step:
+        return "simulation_step";
+    case phase_center_of_mass:
+        return "center_of_mass";
+    case phase_planetary_attraction:
+        return "planetary_attraction";
+    case phase_mutual_gravity:
+        return "mutual_gravity";
+    case phase_continuous_collision:
+        return "continuous_collision";
+    case phase_bounding_boxes:
+        return "bounding_boxes";
+    case phase_collision_particles:
+        return "collision_particles";
+    case phase_collision_planets:
+        return "collision_planets";
+    case phase_collision_black_holes:
+        return "collision_black_holes";
+    case phase_shape_matching:
+        return "shape_matching";
+    case phase_velocity_update:
+        return "velocity_update";
+    case phase_player_displacement:
+        return "player_displacement";
+    case phase_captured_bodies:
+        return "captured_bodies";
+    case phase_culling:
+        return "culling";
+    case phase_update_normals:
+        return "update_normals";
+    case phase_update_drawable:
+        return "update_drawable";
+    case phase_draw:
+        return "draw";
+    default:
+        return "unknown";
+    }
+}
+
+const char *profiler_structure::counter_name(profiler_counter_enum counter)
+{
+    switch (counter)
+    {
+    case counter_bbox_tests:
+        return "bbox_tests";
+    case counter_sphere_tests:
+        return "sphere_tests";
+    case counter_contact_searches:
+        return "contact_searches";
+    case counter_vertex_pair_tests:
+        return "vertex_pair_tests";
+    case counter_contacts_resolved:
+        return "contacts_resolved";
+    case counter_heap_allocations:
+        return "step_heap_allocations";
+    case counter_solver_iterations:
+        return "solver_iterations";
+    default:
+        return "unknown";
+    }
+}
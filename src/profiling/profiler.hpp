@@ -0,0 +1,133 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#include "profiling/trace.hpp"
+
+// Phases of a frame whose duration is measured by the profiler
+enum profiler_phase_enum
+{
+    phase_simulation_step,
+    phase_center_of_mass,
+    phase_planetary_attraction,
+    phase_mutual_gravity,
+    phase_continuous_collision,
+    phase_bounding_boxes,
+    phase_collision_particles,
+    phase_collision_planets,
+    phase_collision_black_holes,
+    phase_shape_matching,
+    phase_velocity_update,
+    phase_player_displacement,
+    phase_captured_bodies,
+    phase_culling,
+    phase_update_normals,
+    phase_update_drawable,
+    phase_draw,
+    phase_count
+};
+
+// Quantities counted by the profiler during a frame
+enum profiler_counter_enum
+{
+    counter_bbox_tests,
+    counter_sphere_tests,
+    counter_contact_searches,
+    counter_vertex_pair_tests,
+    counter_contacts_resolved,
+    counter_heap_allocations,
+    counter_solver_iterations,
+    counter_count
+};
+
+// Rolling window storing the last values of a measure (one value per frame)
+struct rolling_statistics
+{
+    static constexpr int window_size = 256;
+
+    std::array<float, window_size> samples = {};
+    // Number of valid samples in the window
+    int count = 0;
+    // Index of the next sample to overwrite
+    int next = 0;
+
+    void add_sample(float value);
+
+    float average() const;
+    float maximum() const;
+    // Value below which the given ratio (in [0,1]) of the samples falls
+    float percentile(float ratio) const;
+};
+
+// Accumulates the time spent in each phase and the counters during a frame,
+// and keeps rolling statistics over the last frames.
+struct profiler_structure
+{
+    bool enabled = true;
+
+    // Time (ms) and counters accumulated during the current frame (atomic:
+    // the tasks of the frame add to them from several threads)
+    std::array<std::atomic<double>, phase_count> frame_time = {};
+    std::array<std::atomic<long long>, counter_count> frame_counter = {};
+
+    // Statistics over the last frames
+    std::array<rolling_statistics, phase_count> time_statistics;
+    std::array<rolling_statistics, counter_count> counter_statistics;
+
+    void add_time(profiler_phase_enum phase, double milliseconds);
+    void add_count(profiler_counter_enum counter, long long value);
+
+    // Push the values of the current frame to the rolling statistics and
+    // reset them. To be called once at the end of every frame.
+    void end_frame();
+
+    // Display the statistics as an ImGui panel
+    void display_gui();
+    // Write the statistics to a CSV file, return false if it can't be opened
+    bool export_csv(const std::string &filename) const;
+
+    static const char *phase_name(profiler_phase_enum phase);
+    static const char *counter_name(profiler_counter_enum counter);
+};
+
+// Global profiler used by the simulation and the display loop
+extern profiler_structure profiler;
+
+// Measure the time spent between its construction and its destruction, and
+// add it to the given phase of the global profiler. The phase is also traced
+// when the trace recorder is recording.
+class scoped_timer
+{
+public:
+    explicit scoped_timer(profiler_phase_enum phase)
+        : _phase(phase)
+        , _active(profiler.enabled)
+        , _trace(trace_recorder.recording
+                     ? profiler_structure::phase_name(phase)
+                     : nullptr)
+    {
+        if (_active)
+            _start = std::chrono::steady_clock::now();
+    }
+
+    ~scoped_timer()
+    {
+        if (!_active)
+            return;
+        const std::chrono::duration<double, std::milli> elapsed =
+            std::chrono::steady_clock::now() - _start;
+        profiler.add_time(_phase, elapsed.count());
+    }
+
+    scoped_timer(const scoped_timer &) = delete;
+    scoped_timer &operator=(const scoped_timer &) = delete;
+
+private:
+    profiler_phase_enum _phase;
+    bool _active;
+    trace_scope _trace;
+    std::chrono::steady_clock::time_point _start;
+};
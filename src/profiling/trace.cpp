@@ -0,0 +1,79 @@
+#include "profiling/trace.hpp"
+
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+trace_recorder_structure trace_recorder;
+
+void trace_recorder_structure::start()
+{
+    std::lock_guard<std::mutex> lock(events_mutex);
+    events.clear();
+    // Reserve enough room for a few seconds of capture so that recording
+    // doesn't reallocate (and create its own hitches) in the middle of it
+    events.reserve(1 << 20);
+    origin = std::chrono::steady_clock::now();
+    recording = true;
+    std::cout << "Trace recording started" << std::endl;
+}
+
+void trace_recorder_structure::stop()
+{
+    recording = false;
+
+    const std::time_t now = std::time(nullptr);
+    std::ostringstream filename;
+    filename << "trace_" << std::put_time(std::localtime(&now), "%Y%m%d_%H%M%S")
+             << ".json";
+
+    if (export_json(filename.str()))
+        std::cout << "Trace recording stopped: " << events.size()
+                  << " events written to " << filename.str() << std::endl;
+    else
+        std::cerr << "Could not write " << filename.str() << std::endl;
+}
+
+void trace_recorder_structure::toggle()
+{
+    if (recording)
+        stop();
+    else
+        start();
+}
+
+void trace_recorder_structure::add_event(const char *name, char type)
+{
+    const std::chrono::duration<double, std::micro> timestamp =
+        std::chrono::steady_clock::now() - origin;
+    // Small stable identifier of the calling thread for the viewer
+    const int thread =
+        int(std::hash<std::thread::id>()(std::this_thread::get_id()) % 100000);
+
+    std::lock_guard<std::mutex> lock(events_mutex);
+    events.push_back({ name, type, thread, timestamp.count() });
+}
+
+bool trace_recorder_structure::export_json(const std::string &filename) const
+{
+    std::ofstream file(filename);
+    if (!file)
+        return false;
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    for (size_t k = 0; k < events.size(); ++k)
+    {
+        const trace_event &event = events[k];
+        file << "{\"name\":\"" << event.name << "\",\"ph\":\"" << event.type
+             << "\",\"pid\":1,\"tid\":" << event.thread << ",\"ts\":"
+             << std::fixed << std::setprecision(3) << event.timestamp_us << "}"
+             << (k + 1 < events.size() ? ",\n" : "\n");
+    }
+    file << "]}\n";
+
+    return true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// A begin ('B') or end ('E') event of the Chrome trace event format
+struct trace_event
+{
+    // Must point to a string literal: names are not copied
+    const char *name;
+    char type;
+    int thread;
+    double timestamp_us;
+};
+
+// Records begin/end events of the frame stages, to be exported in the Chrome
+// trace event format (readable by chrome://tracing or ui.perfetto.dev).
+// When it is not recording, the only cost of a traced scope is one test.
+struct trace_recorder_structure
+{
+    bool recording = false;
+
+    std::vector<trace_event> events;
+    std::chrono::steady_clock::time_point origin;
+    std::mutex events_mutex;
+
+    // Clear the previous capture and start recording
+    void start();
+    // Stop recording and write the capture to a new trace_*.json file
+    void stop();
+    void toggle();
+
+    void add_event(const char *name, char type);
+    bool export_json(const std::string &filename) const;
+};
+
+// Global trace recorder used by the simulation and the display loop
+extern trace_recorder_structure trace_recorder;
+
+// Emit a begin event at its construction and the matching end event at its
+// destruction, if the trace recorder is recording
+class trace_scope
+{
+public:
+    explicit trace_scope(const char *name)
+        : _name(trace_recorder.recording ? name : nullptr)
+    {
+        if (_name != nullptr)
+            trace_recorder.add_event(_name, 'B');
+    }
+
+    ~trace_scope()
+    {
+        if (_name != nullptr)
+            trace_recorder.add_event(_name, 'E');
+    }
+
+    trace_scope(const trace_scope &) = delete;
+    trace_scope &operator=(const trace_scope &) = delete;
+
+private:
+    const char *_name;
+};
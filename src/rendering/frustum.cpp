@@ -0,0 +1,61 @@
+#include "rendering/frustum.hpp"
+
+#include <cmath>
+
+using namespace cgp;
+
+frustum_structure frustum_structure::from_matrix(const mat4 &M)
+{
+    // Each plane is a sum or difference of the last row of the matrix with
+    // one of the others (left, right, bottom, top, near, far)
+    frustum_structure frustum;
+    for (int k = 0; k < 6; ++k)
+    {
+        const int row = k / 2;
+        const float sign = k % 2 == 0 ? 1.0f : -1.0f;
+        vec4 plane(M(3, 0) + sign * M(row, 0), M(3, 1) + sign * M(row, 1),
+                   M(3, 2) + sign * M(row, 2), M(3, 3) + sign * M(row, 3));
+
+        const float length = std::sqrt(plane.x * plane.x + plane.y * plane.y
+                                       + plane.z * plane.z);
+        frustum.planes[k] = vec4(plane.x / length, plane.y / length,
+                                 plane.z / length, plane.w / length);
+    }
+    return frustum;
+}
+
+bool frustum_structure::intersects_sphere(const vec3 &center,
+                                          float radius) const
+{
+    for (const vec4 &plane : planes)
+    {
+        const float distance = plane.x * center.x + plane.y * center.y
+            + plane.z * center.z + plane.w;
+        if (distance < -radius)
+            return false;
+    }
+    return true;
+}
+
+bool frustum_structure::intersects_box(const bounding_box &box) const
+{
+    for (const vec4 &plane : planes)
+    {
+        // Corner of the box the furthest along the normal of the plane
+        const float x = plane.x >= 0 ? box.p_max.x : box.p_min.x;
+        const float y = plane.y >= 0 ? box.p_max.y : box.p_min.y;
+        const float z = plane.z >= 0 ? box.p_max.z : box.p_min.z;
+        if (plane.x * x + plane.y * y + plane.z * z + plane.w < 0)
+            return false;
+    }
+    return true;
+}
+
+float projected_radius(const mat4 &projection, const vec3 &camera,
+                       const vec3 &center, float radius)
+{
+    const float distance = norm(center - camera);
+    if (distance <= radius)
+        return 1.0f;
+    return radius * projection(1, 1) / distance;
+}
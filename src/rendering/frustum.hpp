@@ -0,0 +1,26 @@
+#pragma once
+
+#include <array>
+
+#include "cgp/cgp.hpp"
+
+// View frustum of the camera as six planes, used to skip the shapes which are
+// not on screen
+struct frustum_structure
+{
+    // Planes (a,b,c,d) with the inside of the frustum where
+    // a x + b y + c z + d >= 0, and (a,b,c) of unit length
+    std::array<cgp::vec4, 6> planes;
+
+    // Extract the planes from the product projection * view
+    static frustum_structure from_matrix(const cgp::mat4 &projection_view);
+
+    // Conservative tests: true if the volume may be visible
+    bool intersects_sphere(const cgp::vec3 &center, float radius) const;
+    bool intersects_box(const cgp::bounding_box &box) const;
+};
+
+// Radius of a sphere once projected on screen, as a fraction of the half
+// height of the screen (projection(1,1) = 1/tan(fov/2))
+float projected_radius(const cgp::mat4 &projection, const cgp::vec3 &camera,
+                       const cgp::vec3 &center, float radius);
@@ -1,10 +1,36 @@
 #include "scene.hpp"
 
+#include <algorithm>
+
+#include "profiling/profiler.hpp"
+#include "profiling/trace.hpp"
+#include "rendering/frustum.hpp"
+
 void scene_structure::initialize(const fs::path &filename)
 {
-    // A sphere used to display the collision model
-    sphere.initialize_data_on_gpu(
-        mesh_primitive_sphere(1.0f, { 0, 0, 0 }, 10, 5));
+    trace_scope trace("load_scene");
+
+    // Instanced drawing of the rigid shapes, one batch per primitive type
+    rigid_batches.resize(primitive_spot + 1);
+    rigid_batch_shader.load(
+        project::path + "shaders/mesh_instanced/mesh_instanced.vert.glsl",
+        project::path + "shaders/mesh/mesh.frag.glsl");
+    batch_renderer.initialize(mesh_drawable::default_shader);
+    // Workers running the tasks of the frames
+    task_pool.start();
+    for (int backend = 0; backend < solver_backend_count; ++backend)
+    {
+        solver_backends[backend] =
+            make_solver_backend(solver_backend_enum(backend), task_pool);
+    }
+
+    // The spheres used to display the collision model, all drawn at once
+    opengl_shader_structure sphere_shader;
+    sphere_shader.load(
+        project::path + "shaders/sphere_instanced/sphere_instanced.vert.glsl",
+        project::path + "shaders/mesh/mesh.frag.glsl");
+    collision_spheres.initialize(
+        mesh_primitive_sphere(1.0f, { 0, 0, 0 }, 10, 5), sphere_shader);
 
     // Initialize the black_hole texture
     black_hole_opengl_image = std::make_unique<
@@ -27,10 +53,103 @@ void scene_structure::initialize(const fs::path &filename)
     initialize_player(scene_config["player"]);
     initialize_planets(planet_config);
     initialize_black_holes(black_hole_config);
+    initialize_physics_lod(scene_config["physics_lod"]);
+    initialize_mutual_gravity(scene_config["mutual_gravity"]);
+    initialize_deformables(scene_config["deformables"]);
+}
+
+void scene_structure::initialize_deformables(
+    const YAML::Node &deformables_config)
+{
+    // Optional: shapes placed at the start of the scene
+    if (!deformables_config)
+    {
+        return;
+    }
+
+    trace_scope trace("load_deformables");
+    static const char *type_names[] = { "cube", "cylinder", "cone", "bunny",
+                                        "spot" };
+    for (auto deformable_iterator = deformables_config.begin();
+         deformable_iterator != deformables_config.end();
+         ++deformable_iterator)
+    {
+        const YAML::Node deformable_config = *deformable_iterator;
+
+        const std::string type_name =
+            deformable_config["type"].as<std::string>("cube");
+        primitive_type_enum primitive_type = primitive_cube;
+        for (int type = primitive_cube; type <= primitive_spot; ++type)
+        {
+            if (type_name == type_names[type])
+                primitive_type = primitive_type_enum(type);
+        }
+
+        const YAML::Node position_config = deformable_config["position"];
+        const vec3 position = { position_config["x"].as<float>(),
+                                position_config["y"].as<float>(),
+                                position_config["z"].as<float>() };
+        vec3 velocity = { 0, 0, 0 };
+        if (const YAML::Node velocity_config = deformable_config["velocity"])
+        {
+            velocity = { velocity_config["x"].as<float>(),
+                         velocity_config["y"].as<float>(),
+                         velocity_config["z"].as<float>() };
+        }
+        vec3 color = { 1, 1, 1 };
+        if (const YAML::Node color_config = deformable_config["color"])
+        {
+            color = { color_config["r"].as<float>(),
+                      color_config["g"].as<float>(),
+                      color_config["b"].as<float>() };
+        }
+
+        add_new_deformable_shape(position, velocity, { 0, 0, 0 }, color,
+                                 primitive_type);
+    }
+    std::cout << "Loaded " << deformables_config.size() << " deformables."
+              << "\n";
+}
+
+void scene_structure::initialize_physics_lod(const YAML::Node &lod_config)
+{
+    // Optional: the physics level of detail is disabled by default
+    if (!lod_config)
+    {
+        return;
+    }
+
+    physics_lod_parameter &lod = param.physics_lod;
+    lod.enabled = lod_config["enabled"].as<bool>(true);
+    lod.near_distance =
+        lod_config["near_distance"].as<float>(lod.near_distance);
+    lod.far_distance = lod_config["far_distance"].as<float>(lod.far_distance);
+    lod.mid_collision_steps =
+        lod_config["mid_collision_steps"].as<int>(lod.mid_collision_steps);
+    lod.far_tick_interval =
+        lod_config["far_tick_interval"].as<int>(lod.far_tick_interval);
+}
+
+void scene_structure::initialize_mutual_gravity(
+    const YAML::Node &gravity_config)
+{
+    // Optional: the shapes don't attract each other by default
+    if (!gravity_config)
+    {
+        return;
+    }
+
+    mutual_gravity_parameter &gravity = param.mutual_gravity;
+    gravity.enabled = gravity_config["enabled"].as<bool>(true);
+    gravity.strength = gravity_config["strength"].as<float>(gravity.strength);
+    gravity.theta = gravity_config["theta"].as<float>(gravity.theta);
+    gravity.softening =
+        gravity_config["softening"].as<float>(gravity.softening);
 }
 
 void scene_structure::initialize_skybox(const YAML::Node &skybox_config)
 {
+    trace_scope trace("load_skybox");
     skybox = std::move(std::make_unique<Skybox>(skybox_config));
 }
 
@@ -62,23 +181,31 @@ void scene_structure::initialize_player(const YAML::Node &player_config)
     const cgp::vec3 player_size = { player_size_config["x"].as<float>(),
                                     player_size_config["y"].as<float>(),
                                     player_size_config["z"].as<float>() };
-    shape_deformable_structure player;
-    player.initialize(mesh_primitive_ellipsoid(player_size));
-    player.set_position_and_velocity(player_position);
-    deformables.push_back(player);
+    shape_deformable_structure player_shape;
+    player_shape.initialize(mesh_primitive_ellipsoid(player_size));
+    player_shape.set_position_and_velocity(player_position);
+    player = deformables.insert(std::move(player_shape));
 }
 
 void scene_structure::initialize_planets(const YAML::Node &planets_config)
 {
+    trace_scope trace("load_planets");
     std::cout << "Loading " << planets_config.size() << " planets." << "\n";
     for (auto planet_id_iterator = planets_config.begin(); planet_id_iterator !=
          planets_config.end(); ++planet_id_iterator)
     {
-        int planet_id = planet_id_iterator->as<int>();
-        std::ostringstream filename;
-        filename << "config/planets/planet_" << std::setw(2) <<
-            std::setfill('0') << planet_id << ".yaml";
-        YAML::Node planet_config = YAML::LoadFile(filename.str());
+        // A planet is either described in the scene (generated scenes), or
+        // given by the id of its file
+        YAML::Node planet_config = *planet_id_iterator;
+        if (!planet_config.IsMap())
+        {
+            int planet_id = planet_id_iterator->as<int>();
+            std::ostringstream filename;
+            filename << "config/planets/planet_" << std::setw(2) <<
+                std::setfill('0') << planet_id << ".yaml";
+            planet_config = YAML::LoadFile(filename.str());
+            std::cout << "Loaded planet: " << planet_id << "\n";
+        }
 
         const YAML::Node planet_position_config = planet_config["position"];
         const cgp::vec3 planet_position = {
@@ -91,22 +218,27 @@ void scene_structure::initialize_planets(const YAML::Node &planets_config)
 
         planets.emplace_back(planet_radius, planet_attraction_radius,
                              planet_position);
-        std::cout << "Loaded planet: " << planet_id << "\n";
     }
 }
 
 void scene_structure::initialize_black_holes(
     const YAML::Node &black_holes_config)
 {
+    trace_scope trace("load_black_holes");
     for (auto black_hole_id_iterator = black_holes_config.begin();
          black_hole_id_iterator != black_holes_config.end();
          ++black_hole_id_iterator)
     {
-        int black_hole_id = black_hole_id_iterator->as<int>();
-        std::ostringstream filename;
-        filename << "config/black_holes/black_hole_" << std::setw(2) <<
-            std::setfill('0') << black_hole_id << ".yaml";
-        YAML::Node black_hole_config = YAML::LoadFile(filename.str());
+        // Described in the scene, or given by the id of its file
+        YAML::Node black_hole_config = *black_hole_id_iterator;
+        if (!black_hole_config.IsMap())
+        {
+            int black_hole_id = black_hole_id_iterator->as<int>();
+            std::ostringstream filename;
+            filename << "config/black_holes/black_hole_" << std::setw(2) <<
+                std::setfill('0') << black_hole_id << ".yaml";
+            black_hole_config = YAML::LoadFile(filename.str());
+        }
 
         const YAML::Node black_hole_position_config = black_hole_config[
             "position"];
@@ -118,9 +250,8 @@ void scene_structure::initialize_black_holes(
         const float black_hole_attraction_radius = black_hole_config[
             "attraction_radius"].as<float>();
 
-        black_holes.emplace_back(black_hole_radius,
-                                 black_hole_attraction_radius,
-                                 black_hole_position);
+        black_holes.emplace(black_hole_radius, black_hole_attraction_radius,
+                            black_hole_position);
     }
 }
 
@@ -129,57 +260,270 @@ void scene_structure::display_frame()
     // Set the light to the current position of the camera
     environment.light = camera_control.camera_model.position();
 
-    skybox->update_mesh_from_camera(
-        camera_control.camera_model);
-    cgp::mesh_drawable drawable = skybox->update_drawable();
-    draw(drawable);
-    if (gui.display_wireframe)
+    // The frame is a graph of tasks: the solver, the meshes turned toward the
+    // camera and the planets are prepared at the same time by the task pool,
+    // and the OpenGL calls are made on this thread as soon as their data is
+    // ready. The tasks are added in an order valid for a sequential run.
+    frame_graph.clear();
+
+    const int prepare_view = frame_graph.add("prepare_view", [this] {
+        skybox->update_mesh_from_camera(camera_control.camera_model);
+        for (int k = 0; k < black_holes.size(); k++)
+        {
+            black_holes[k].update_mesh_from_camera(
+                camera_control.camera_model);
+        }
+    });
+    const int draw_skybox = frame_graph.add(
+        "skybox",
+        [this] {
+            cgp::mesh_drawable drawable = skybox->update_drawable();
+            draw(drawable);
+            if (gui.display_wireframe)
+            {
+                draw_wireframe(drawable);
+            }
+            if (gui.display_frame)
+                draw(global_frame, environment);
+        },
+        task_main_thread);
+    frame_graph.depends_on(draw_skybox, prepare_view);
+
+    const int simulate = frame_graph.add("simulate",
+                                         [this] { simulate_frame(); });
+
+    // The planets don't depend on the simulation
+    const int cull_planets_task =
+        frame_graph.add("cull_planets", [this] { cull_planets(); });
+    const int planet_normals = frame_graph.add("planet_normals", [this] {
+        scoped_timer timer(phase_update_normals);
+        task_pool.parallel_for(planets.size(), 1, [this](int begin, int end) {
+            for (int planet_index = begin; planet_index < end; planet_index++)
+            {
+                if (is_planet_drawn_full(planet_index))
+                {
+                    planets[planet_index].get_shape().update_normals();
+                }
+            }
+        });
+    });
+    frame_graph.depends_on(planet_normals, cull_planets_task);
+
+    // The normals of each shape are computed as soon as its visibility is
+    // known, by blocks of shapes spread over the workers
+    const int cull_shapes_task =
+        frame_graph.add("cull_shapes", [this] { cull_shapes(); });
+    frame_graph.depends_on(cull_shapes_task, simulate);
+    const int shape_normals = frame_graph.add("shape_normals", [this] {
+        scoped_timer timer(phase_update_normals);
+        task_pool.parallel_for(deformables.size(), 4, [this](int begin,
+                                                             int end) {
+            for (int k = begin; k < end; ++k)
+            {
+                if (deformable_visible[k]
+                    && !is_drawn_as_rigid(deformables[k]))
+                {
+                    deformables[k].update_normals();
+                }
+            }
+        });
+    });
+    frame_graph.depends_on(shape_normals, cull_shapes_task);
+
+    const int upload_shapes_task = frame_graph.add(
+        "upload_shapes", [this] { upload_shapes(); }, task_main_thread);
+    frame_graph.depends_on(upload_shapes_task, shape_normals);
+    const int upload_planets_task = frame_graph.add(
+        "upload_planets", [this] { upload_planets(); }, task_main_thread);
+    frame_graph.depends_on(upload_planets_task, planet_normals);
+
+    const int draw_task =
+        frame_graph.add("draw", [this] { draw_scene(); }, task_main_thread);
+    frame_graph.depends_on(draw_task, draw_skybox);
+    frame_graph.depends_on(draw_task, upload_shapes_task);
+    frame_graph.depends_on(draw_task, upload_planets_task);
+
+    if (gui.parallel_frame)
     {
-        draw_wireframe(drawable);
+        frame_graph.run(task_pool);
     }
+    else
+    {
+        frame_graph.run_sequential();
+    }
+}
 
-    if (gui.display_frame)
-        draw(global_frame, environment);
-
+void scene_structure::simulate_frame()
+{
     timer.update();
 
     // Compute the simulation
     if (param.time_step > 1e-6f)
     {
-        simulation_step(deformables, planets, black_holes, param,
-                        camera_control.camera_model);
+        active_backend = param.backend;
+        if (gui.backend_ab
+            && (simulated_steps / std::max(1, gui.backend_ab_interval)) % 2
+                == 1)
+        {
+            active_backend = gui.backend_b;
+        }
+        ++simulated_steps;
+
+        last_report = simulation_step(
+            deformables, player, camera_control.camera_model.position(),
+            planets, black_holes, param, *solver_backends[active_backend],
+            step_arena);
+
+        // Only the simulation has measured these phases so far in the frame
+        if (profiler.enabled)
+        {
+            for (int phase = phase_simulation_step;
+                 phase <= phase_player_displacement; ++phase)
+            {
+                backend_statistics[active_backend][phase].add_sample(
+                    float(profiler.frame_time[phase].load()));
+            }
+        }
+
+        // The black-holed deformables leave the simulation, and are only
+        // animated as a whole until they disappear
+        capture_black_holed_shapes(deformables, captured_bodies);
+        animate_captured_bodies(captured_bodies, black_holes, param,
+                                camera_control.camera_model);
+    }
+
+    const shape_deformable_structure *player_shape = deformables.get(player);
+    for (int planet_index = 0;
+         player_shape != nullptr && planet_index < planets.size();
+         planet_index++)
+    {
+        if (planets[planet_index].should_attract_deformable(*player_shape))
+        {
+            cgp::vec3 normal = normalize(
+                player_shape->com - planets[planet_index].get_center());
+            //camera_control.look_at(player_shape->com + normal * 1.6 * planets[planet_index].get_radius(), player_shape->com);
+        }
+    }
+}
+
+// Skip the shapes out of the view
+void scene_structure::cull_shapes()
+{
+    scoped_timer timer(phase_culling);
+    const frustum_structure frustum = frustum_structure::from_matrix(
+        environment.camera_projection * environment.camera_view);
+
+    const int N_deformable = deformables.size();
+    deformable_visible.resize(N_deformable);
+    task_pool.parallel_for(N_deformable, 16, [&](int begin, int end) {
+        for (int k = begin; k < end; ++k)
+        {
+            bounding_box box;
+            box.initialize(deformables[k].position);
+            deformable_visible[k] =
+                !gui.frustum_culling || frustum.intersects_box(box);
+        }
+    });
+}
+
+// Skip the planets out of the view, and select their level of detail from
+// their size on screen
+void scene_structure::cull_planets()
+{
+    scoped_timer timer(phase_culling);
+    const frustum_structure frustum = frustum_structure::from_matrix(
+        environment.camera_projection * environment.camera_view);
+    const vec3 camera_position = camera_control.camera_model.position();
+
+    const int N_planet = planets.size();
+    planet_visible.resize(N_planet);
+    planet_lod.resize(N_planet);
+    for (int planet_index = 0; planet_index < N_planet; planet_index++)
+    {
+        const Planet &planet = planets[planet_index];
+        planet_visible[planet_index] = !gui.frustum_culling
+            || frustum.intersects_sphere(planet.get_center(),
+                                         planet.get_radius());
+        planet_lod[planet_index] = !gui.planet_lod
+            ? 0
+            : Planet::select_lod(projected_radius(
+                  environment.camera_projection, camera_position,
+                  planet.get_center(), planet.get_radius()));
     }
+}
 
-    // Delete the black-holed deformables
-    for (auto deformable = deformables.cbegin(); deformables.cend() !=
-         deformable;)
+// Send the new positions and normals of the shapes to the GPU (or only their
+// rigid transform when they don't deform)
+void scene_structure::upload_shapes()
+{
+    scoped_timer timer(phase_update_drawable);
+    for (RigidBatch &batch : rigid_batches)
+    {
+        batch.clear_instances();
+    }
+    batched_shapes.clear();
+    for (int k = 0; k < deformables.size(); ++k)
     {
-        // TODO : not the actual timer in seconds...
-        if (deformable->got_black_holed != nullptr && deformable->dt_timer >=
-            param.black_hole_timer)
+        if (!deformable_visible[k])
+        {
+            continue;
+        }
+        if (is_drawn_as_rigid(deformables[k]))
         {
-            deformable = deformables.erase(deformable);
+            rigid_batches[deformables[k].rigid_batch].add_instance(
+                deformables[k]);
+        }
+        else if (is_drawn_batched(deformables[k]))
+        {
+            batched_shapes.push_back(k);
         }
         else
         {
-            ++deformable;
+            deformables[k].upload_drawable();
         }
     }
+    batch_renderer.update(deformables, batched_shapes, task_pool);
 
+    // Last upload of the vertices of the shapes captured in this frame
+    for (captured_body_structure &body : captured_bodies)
+    {
+        if (!body.uploaded)
+        {
+            body.shape.upload_drawable();
+            body.uploaded = true;
+        }
+    }
+}
+
+void scene_structure::upload_planets()
+{
+    scoped_timer timer(phase_update_drawable);
     for (int planet_index = 0; planet_index < planets.size(); planet_index++)
     {
-        if (planets[planet_index].should_attract_deformable(deformables[0]))
+        if (is_planet_drawn_full(planet_index))
         {
-            cgp::vec3 normal = normalize(
-                deformables[0].com - planets[planet_index].get_center());
-            //camera_control.look_at(deformables[0].com + normal * 1.6 * planets[planet_index].get_radius(), deformables[0].com);
+            planets[planet_index].get_shape().upload_drawable();
         }
     }
+}
+
+void scene_structure::draw_scene()
+{
+    scoped_timer draw_timer(phase_draw);
 
     // Display all the deformable shapes
+    for (RigidBatch &batch : rigid_batches)
+    {
+        batch.draw(environment, gui.display_wireframe);
+    }
+    batch_renderer.draw(environment, gui.display_wireframe);
     for (int k = 0; k < deformables.size(); ++k)
     {
-        deformables[k].update_drawable();
+        if (!deformable_visible[k] || is_drawn_as_rigid(deformables[k])
+            || is_drawn_batched(deformables[k]))
+        {
+            continue;
+        }
         draw(deformables[k].drawable);
         if (gui.display_wireframe)
         {
@@ -187,16 +531,29 @@ void scene_structure::display_frame()
         }
     }
 
+    for (const captured_body_structure &body : captured_bodies)
+    {
+        draw(body.shape.drawable);
+        if (gui.display_wireframe)
+        {
+            draw_wireframe(body.shape.drawable);
+        }
+    }
+
     // display the planets
 
     for (int planet_index = 0; planet_index < planets.size(); planet_index++)
     {
-        shape_deformable_structure &shape = planets[planet_index].get_shape();
-        shape.update_drawable();
-        draw(shape.drawable);
+        if (!planet_visible[planet_index])
+        {
+            continue;
+        }
+        const mesh_drawable &drawable =
+            planets[planet_index].get_lod_drawable(planet_lod[planet_index]);
+        draw(drawable);
         if (gui.display_wireframe)
         {
-            draw_wireframe(shape.drawable);
+            draw_wireframe(drawable);
         }
     }
 
@@ -204,28 +561,23 @@ void scene_structure::display_frame()
     if (gui.display_walls)
         draw(wall);
 
-    // Display the vertices with their colliding spheres (slower the display for
-    // many vertices)
+    // Display the vertices with their colliding spheres, in a single
+    // instanced draw call
     if (gui.display_collision_sphere)
     {
+        collision_spheres.clear();
         for (int k = 0; k < deformables.size(); ++k)
         {
-            sphere.model.scaling = param.collision_radius;
-            for (int kv = 0; kv < deformables[k].position.size(); ++kv)
-            {
-                sphere.model.translation = deformables[k].position[kv];
-                draw(sphere, environment);
-            }
+            collision_spheres.add(deformables[k].position);
         }
+        collision_spheres.draw(environment, param.collision_radius);
     }
 
-    // display the black holes
+    // display the black holes (turned toward the camera by prepare_view)
 
     for (int black_hole_index = 0; black_hole_index < black_holes.size();
          black_hole_index++)
     {
-        black_holes[black_hole_index].update_mesh_from_camera(
-            camera_control.camera_model);
         cgp::mesh_drawable drawable = black_holes[black_hole_index].
             update_drawable();
         draw(drawable);
@@ -246,6 +598,21 @@ void scene_structure::display_gui()
 
     ImGui::Spacing();
     ImGui::Checkbox("Display collision spheres", &gui.display_collision_sphere);
+    // Only used while the shapes can't deform (PPD without elasticity)
+    ImGui::Checkbox("Rigid rendering (instanced)", &gui.rigid_rendering);
+    ImGui::Checkbox("Batched rendering (multi-draw)", &gui.batched_rendering);
+    ImGui::Checkbox("Parallel frame (task graph)", &gui.parallel_frame);
+    ImGui::SameLine();
+    ImGui::Text("%d workers", task_pool.worker_count());
+    ImGui::Checkbox("Frustum culling", &gui.frustum_culling);
+    ImGui::SameLine();
+    ImGui::Checkbox("Planet LOD", &gui.planet_lod);
+    ImGui::Text("Visible: %d/%d shapes, %d/%d planets",
+                int(std::count(deformable_visible.begin(),
+                               deformable_visible.end(), 1)),
+                int(deformable_visible.size()),
+                int(std::count(planet_visible.begin(), planet_visible.end(), 1)),
+                int(planet_visible.size()));
     ImGui::SliderFloat("Collision radius", &param.collision_radius, 0.001f,
                        0.1f);
 
@@ -264,11 +631,77 @@ void scene_structure::display_gui()
     ImGui::RadioButton("Spot", ptr_primitive_type, primitive_spot);
 
     ImGui::Spacing();
-    ImGui::SliderFloat("Time step", &param.time_step, 0, 0.01f, "%.5f", 2.0f);
+    // Larger time steps are usable thanks to the continuous collisions
+    ImGui::SliderFloat("Time step", &param.time_step, 0, 0.03f, "%.5f", 2.0f);
     ImGui::SliderInt("Collision steps", &param.collision_steps, 1, 10);
+    ImGui::Checkbox("Adaptive iterations", &param.adaptive_iterations);
+    if (param.adaptive_iterations)
+    {
+        ImGui::SliderInt("Min collision steps", &param.min_collision_steps, 1,
+                         param.collision_steps);
+        ImGui::SliderFloat("Residual tolerance", &param.residual_tolerance,
+                           1e-6f, 1e-2f, "%.1e", 4.0f);
+    }
+    ImGui::Text("Iterations: %d, residual: %.2e", last_report.iterations,
+                last_report.residual);
+    ImGui::Checkbox("Continuous collision", &param.continuous_collision);
+    ImGui::Checkbox("Physics LOD", &param.physics_lod.enabled);
+    if (param.physics_lod.enabled)
+    {
+        physics_lod_parameter &lod = param.physics_lod;
+        ImGui::SliderFloat("Near distance", &lod.near_distance, 0.0f,
+                           lod.far_distance);
+        ImGui::SliderFloat("Far distance", &lod.far_distance,
+                           lod.near_distance, 50.0f);
+        ImGui::SliderInt("Mid collision steps", &lod.mid_collision_steps, 1,
+                         param.collision_steps);
+        ImGui::SliderInt("Far tick interval", &lod.far_tick_interval, 1, 10);
+        int lod_count[3] = {};
+        for (const shape_deformable_structure &deformable : deformables)
+        {
+            ++lod_count[deformable.physics_lod];
+        }
+        ImGui::Text("Near: %d, mid: %d, far: %d shapes", lod_count[0],
+                    lod_count[1], lod_count[2]);
+    }
     ImGui::SliderFloat("Friction with air", &param.friction, 0.001f, 0.1f,
                        "%.4f", 2);
-    ImGui::SliderFloat("Elasticity", &param.elasticity, 0, 1);
+    ImGui::Checkbox("Mutual gravity (Barnes-Hut)",
+                    &param.mutual_gravity.enabled);
+    if (param.mutual_gravity.enabled)
+    {
+        mutual_gravity_parameter &gravity = param.mutual_gravity;
+        ImGui::SliderFloat("Gravity strength", &gravity.strength, 0.0f,
+                           0.05f, "%.4f", 2.0f);
+        ImGui::SliderFloat("Opening angle", &gravity.theta, 0.0f, 1.5f);
+        ImGui::SliderFloat("Softening", &gravity.softening, 0.01f, 1.0f);
+    }
+    ImGui::Checkbox("Contact cache", &param.contact_cache.enabled);
+    if (param.contact_cache.enabled)
+    {
+        ImGui::SliderFloat("Contact skin", &param.contact_cache.skin, 0.0f,
+                           param.collision_radius);
+    }
+
+    ImGui::Spacing();
+    ImGui::Text("Solver:");
+    int *ptr_solver = reinterpret_cast<int *>(&param.solver);
+    ImGui::RadioButton("PPD", ptr_solver, solver_ppd);
+    ImGui::SameLine();
+    ImGui::RadioButton("XPBD", ptr_solver, solver_xpbd);
+    display_backend_gui();
+    if (param.solver == solver_xpbd)
+    {
+        // Compliance = 1 / stiffness, independent of the time step
+        ImGui::SliderFloat("Shape compliance", &param.shape_compliance, 0.0f,
+                           1e-4f, "%.2e", 4.0f);
+        ImGui::SliderFloat("Contact compliance", &param.contact_compliance,
+                           0.0f, 1e-4f, "%.2e", 4.0f);
+    }
+    else
+    {
+        ImGui::SliderFloat("Elasticity", &param.elasticity, 0, 1);
+    }
     ImGui::SliderFloat("Plasticity", &param.plasticity, 0, 1);
 
     ImGui::Spacing();
@@ -283,6 +716,88 @@ void scene_structure::display_gui()
         throw_new_deformable_shape();
     }
     ImGui::PopStyleColor();
+
+    ImGui::Spacing();
+    if (ImGui::CollapsingHeader("Profiler"))
+    {
+        ImGui::Indent();
+        profiler.display_gui();
+        ImGui::Unindent();
+    }
+}
+
+void scene_structure::display_backend_gui()
+{
+    ImGui::Text("Backend:");
+    int *ptr_backend = reinterpret_cast<int *>(&param.backend);
+    for (int backend = 0; backend < solver_backend_count; ++backend)
+    {
+        if (backend > 0)
+            ImGui::SameLine();
+        ImGui::RadioButton(solver_backends[backend]->name(), ptr_backend,
+                           backend);
+    }
+    if (active_backend == backend_specialized)
+    {
+        const auto &specialized = static_cast<const SpecializedSolverBackend &>(
+            *solver_backends[backend_specialized]);
+        ImGui::Text("Pipeline: %s",
+                    specialized.configuration().description().c_str());
+    }
+
+    ImGui::Checkbox("A/B alternate with", &gui.backend_ab);
+    if (gui.backend_ab)
+    {
+        int *ptr_backend_b = reinterpret_cast<int *>(&gui.backend_b);
+        for (int backend = 0; backend < solver_backend_count; ++backend)
+        {
+            ImGui::SameLine();
+            // Distinct ids: the names are already used by the buttons above
+            ImGui::PushID(backend);
+            ImGui::RadioButton(solver_backends[backend]->name(),
+                               ptr_backend_b, backend);
+            ImGui::PopID();
+        }
+        ImGui::SliderInt("Steps per backend", &gui.backend_ab_interval, 1,
+                         240);
+    }
+
+    if (ImGui::TreeNode("Phases per backend (ms)"))
+    {
+        ImGui::Columns(solver_backend_count + 1, "backend_phases");
+        ImGui::Text("Phase");
+        ImGui::NextColumn();
+        for (int backend = 0; backend < solver_backend_count; ++backend)
+        {
+            ImGui::Text("%s%s", solver_backends[backend]->name(),
+                        backend == active_backend ? " *" : "");
+            ImGui::NextColumn();
+        }
+        ImGui::Separator();
+        for (int phase = phase_simulation_step;
+             phase <= phase_player_displacement; ++phase)
+        {
+            ImGui::Text("%s", profiler_structure::phase_name(
+                                  profiler_phase_enum(phase)));
+            ImGui::NextColumn();
+            for (int backend = 0; backend < solver_backend_count; ++backend)
+            {
+                const rolling_statistics &statistics =
+                    backend_statistics[backend][phase];
+                if (statistics.count > 0)
+                    ImGui::Text("%.3f", statistics.average());
+                else
+                    ImGui::Text("-");
+                ImGui::NextColumn();
+            }
+        }
+        ImGui::Columns(1);
+        if (ImGui::Button("Reset"))
+        {
+            backend_statistics = {};
+        }
+        ImGui::TreePop();
+    }
 }
 
 // Generate a new deformable shape appearing in front of the camera with an
@@ -306,17 +821,17 @@ void scene_structure::throw_new_deformable_shape()
     vec3 color = color_lut[int(rand_uniform(0, color_lut.size()))];
 
     // Create the new deformable shape
-    add_new_deformable_shape(p0, v0, angular_velocity, color);
+    add_new_deformable_shape(p0, v0, angular_velocity, color,
+                             gui.primitive_type);
 }
 
-void scene_structure::add_new_deformable_shape(vec3 const &center,
-                                               vec3 const &velocity,
-                                               vec3 const &angular_velocity,
-                                               vec3 const &color)
+void scene_structure::add_new_deformable_shape(
+    vec3 const &center, vec3 const &velocity, vec3 const &angular_velocity,
+    vec3 const &color, primitive_type_enum primitive_type)
 {
     // Initialize default primitive mesh
     mesh m;
-    switch (gui.primitive_type)
+    switch (primitive_type)
     {
     case primitive_cube: {
         float L = 0.1;
@@ -346,15 +861,27 @@ void scene_structure::add_new_deformable_shape(vec3 const &center,
         break;
     }
     case primitive_bunny: {
-        m = mesh_load_file_obj(project::path + "assets/bunny.obj");
-        m.scale(1.5f);
-        m.flip_connectivity();
+        // The files are only loaded by the first shape of their type
+        if (bunny_mesh.position.size() == 0)
+        {
+            trace_scope trace("load_bunny");
+            bunny_mesh =
+                mesh_load_file_obj(project::path + "assets/bunny.obj");
+            bunny_mesh.scale(1.5f);
+            bunny_mesh.flip_connectivity();
+        }
+        m = bunny_mesh;
         m.color.fill(color);
         break;
     }
     case primitive_spot: {
-        m = mesh_load_file_obj(project::path + "assets/spot.obj");
-        m.scale(0.25f);
+        if (spot_mesh.position.size() == 0)
+        {
+            trace_scope trace("load_spot");
+            spot_mesh = mesh_load_file_obj(project::path + "assets/spot.obj");
+            spot_mesh.scale(0.25f);
+        }
+        m = spot_mesh;
         break;
     }
     }
@@ -367,15 +894,58 @@ void scene_structure::add_new_deformable_shape(vec3 const &center,
     deformable.initialize(m);
     deformable.set_position_and_velocity(center, velocity, angular_velocity);
 
-    // Special case for spot: set the texture
-    if (gui.primitive_type == primitive_spot)
+    // Special case for spot: set the texture (shared by all the spots)
+    if (primitive_type == primitive_spot)
+    {
+        if (spot_texture.id == 0)
+        {
+            trace_scope trace("load_spot_texture");
+            spot_texture.load_and_initialize_texture_2d_on_gpu(
+                project::path + "assets/spot_texture.png");
+        }
+        deformable.drawable.texture = spot_texture;
+        deformable.use_batch_renderer = false;
+    }
+
+    // The color is given per instance when the shape is drawn as rigid (spot
+    // keeps the colors of its texture)
+    deformable.color = primitive_type == primitive_spot ? vec3(1, 1, 1)
+                                                        : color;
+    RigidBatch &batch = rigid_batches[primitive_type];
+    if (!batch.is_initialized())
     {
-        deformable.drawable.texture.load_and_initialize_texture_2d_on_gpu(
-            project::path + "assets/spot_texture.png");
+        // The primitives of a type all have the same rest mesh
+        mesh rest_mesh = m;
+        rest_mesh.color.fill({ 1, 1, 1 });
+        batch.initialize(rest_mesh, rigid_batch_shader,
+                         deformable.drawable.texture);
     }
+    deformable.rigid_batch = primitive_type;
 
     // Add the new deformable structure
-    deformables.push_back(deformable);
+    deformables.insert(std::move(deformable));
+}
+
+bool scene_structure::is_drawn_as_rigid(
+    const shape_deformable_structure &deformable) const
+{
+    // The shape matching keeps the shapes rigid only with the PPD solver
+    // without elasticity nor plasticity
+    return gui.rigid_rendering && deformable.rigid_batch >= 0
+        && param.solver == solver_ppd && param.elasticity == 0.0f
+        && param.plasticity == 0.0f;
+}
+
+bool scene_structure::is_planet_drawn_full(int planet_index) const
+{
+    return planet_visible[planet_index] && planet_lod[planet_index] == 0;
+}
+
+bool scene_structure::is_drawn_batched(
+    const shape_deformable_structure &deformable) const
+{
+    return gui.batched_rendering && deformable.use_batch_renderer
+        && !is_drawn_as_rigid(deformable);
 }
 
 void scene_structure::mouse_move_event()
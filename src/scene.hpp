@@ -1,14 +1,23 @@
 #pragma once
 
+#include <array>
 #include <filesystem>
 #include <memory>
 
 #include <yaml-cpp/yaml.h>
 
+#include "deformable/batch_renderer.hpp"
+#include "deformable/rigid_batch.hpp"
 #include "environment.hpp"
 #include "objects/black_hole.hpp"
+#include "objects/instanced_spheres.hpp"
 #include "objects/planet.hpp"
+#include "profiling/profiler.hpp"
+#include "scheduling/task_graph.hpp"
+#include "scheduling/task_pool.hpp"
+#include "simulation/captured_body.hpp"
 #include "simulation/simulation.hpp"
+#include "simulation/solver_backend.hpp"
 
 #include "skybox/skybox.hpp"
 
@@ -30,6 +39,23 @@ struct gui_parameters
     bool display_frame = true;
     bool display_wireframe = true;
     bool display_collision_sphere = false;
+    // Draw the shapes which don't deform with one instanced call per
+    // primitive type, uploading only their rigid transform
+    bool rigid_rendering = true;
+    // Draw the other shapes from a single vertex buffer with one multi-draw
+    // call
+    bool batched_rendering = true;
+    // Skip the shapes out of the view of the camera
+    bool frustum_culling = true;
+    // Draw the far away planets with coarser meshes
+    bool planet_lod = true;
+    // Run the tasks of the frame on the task pool (sequentially otherwise)
+    bool parallel_frame = true;
+    // A/B comparison: the solver backend alternates between the one of the
+    // parameters and backend_b every backend_ab_interval steps
+    bool backend_ab = false;
+    solver_backend_enum backend_b = backend_threaded;
+    int backend_ab_interval = 30;
     bool display_walls = true;
     primitive_type_enum primitive_type;
     float throwing_speed = 10.0f;
@@ -57,20 +83,67 @@ struct scene_structure : scene_inputs_generic
     cgp::timer_basic timer;
 
     simulation_parameter param;
+    // Convergence of the last simulation step
+    simulation_report last_report;
+    // Scratch memory of the simulation, reset at every step
+    StepArena step_arena;
+    // Implementations of the passes of the solver (indexed by
+    // solver_backend_enum), the one of the last step, and the duration of the
+    // phases of the steps run by each of them
+    std::array<std::unique_ptr<SolverBackend>, solver_backend_count>
+        solver_backends;
+    solver_backend_enum active_backend = backend_simd;
+    std::array<std::array<rolling_statistics, phase_count>,
+               solver_backend_count>
+        backend_statistics;
+    int simulated_steps = 0;
     std::unique_ptr<Skybox>  skybox = nullptr;
-    std::vector<shape_deformable_structure> deformables;
+    deformable_store deformables;
+    // Handle of the deformable shape controlled by the player
+    slot_handle player;
     std::vector<Planet> planets = std::vector<Planet>();
-    std::vector<BlackHole> black_holes = std::vector<BlackHole>();
+    SlotMap<BlackHole> black_holes;
+    // Shapes falling into a black hole, out of the simulation
+    std::vector<captured_body_structure> captured_bodies;
+    // Instanced drawing of the rigid shapes, one batch per primitive type
+    // (indexed by primitive_type_enum)
+    std::vector<RigidBatch> rigid_batches;
+    opengl_shader_structure rigid_batch_shader;
+    // Shared vertex buffer of the deformed shapes, and the shapes it draws in
+    // the current frame (dense indices in the deformables)
+    BatchRenderer batch_renderer;
+    std::vector<int> batched_shapes;
+    // Visibility of the shapes (dense indices) and planets in the current
+    // frame, and level of detail of the planets
+    std::vector<char> deformable_visible;
+    std::vector<char> planet_visible;
+    std::vector<int> planet_lod;
     std::unique_ptr<opengl_texture_image_structure> black_hole_opengl_image;
+    // Worker threads, and the tasks of the current frame
+    TaskPool task_pool;
+    TaskGraph frame_graph;
 
     void add_new_deformable_shape(vec3 const &center, vec3 const &velocity,
                                   vec3 const &angular_velocity,
-                                  vec3 const &color);
-
-    mesh_drawable sphere;
+                                  vec3 const &color,
+                                  primitive_type_enum primitive_type);
+    // Meshes loaded from files, kept for the next shapes of their type
+    mesh bunny_mesh;
+    mesh spot_mesh;
+    opengl_texture_image_structure spot_texture;
+
+    InstancedSpheres collision_spheres;
     mesh_drawable wall;
     void throw_new_deformable_shape();
 
+    // Whether the shape is drawn by its rigid batch in the current frame
+    bool is_drawn_as_rigid(const shape_deformable_structure &deformable) const;
+    // Whether the shape is drawn by the batch renderer in the current frame
+    bool is_drawn_batched(const shape_deformable_structure &deformable) const;
+    // Whether the planet is drawn with the mesh of its shape (visible and
+    // close enough), which then needs to be updated
+    bool is_planet_drawn_full(int planet_index) const;
+
     // ****************************** //
     // Functions
     // ****************************** //
@@ -80,13 +153,26 @@ struct scene_structure : scene_inputs_generic
     void initialize_player(const YAML::Node &player_config);
     void initialize_planets(const YAML::Node &planets_config);
     void initialize_black_holes(const YAML::Node &black_holes_config);
+    void initialize_physics_lod(const YAML::Node &lod_config);
+    void initialize_mutual_gravity(const YAML::Node &gravity_config);
+    void initialize_deformables(const YAML::Node &deformables_config);
 
     void initialize(const fs::path& filename); // Standard initialization to be called before the
                        // animation loop
     void
     display_frame(); // The frame display to be called within the animation loop
+    // Tasks of a frame (see display_frame)
+    void simulate_frame();
+    void cull_shapes();
+    void cull_planets();
+    void upload_shapes();
+    void upload_planets();
+    void draw_scene();
     void display_gui(); // The display of the GUI, also called within the
                         // animation loop
+    // Selection of the solver backend, and the duration of the phases of the
+    // simulation with each backend side by side
+    void display_backend_gui();
 
     void mouse_move_event();
     void mouse_click_event();
@@ -0,0 +1,124 @@
+#include "scheduling/task_graph.hpp"
+
+#include <cassert>
+
+#include "profiling/trace.hpp"
+
+int TaskGraph::add(const char *name, task_function function,
+                   task_thread_enum thread)
+{
+    task_node node;
+    node.name = name;
+    node.function = std::move(function);
+    node.thread = thread;
+    _tasks.push_back(std::move(node));
+    return _tasks.size() - 1;
+}
+
+void TaskGraph::depends_on(int task, int dependency)
+{
+    assert(dependency < task);
+    _tasks[dependency].successors.push_back(task);
+    ++_tasks[task].dependency_count;
+}
+
+void TaskGraph::clear()
+{
+    _tasks.clear();
+}
+
+int TaskGraph::size() const
+{
+    return _tasks.size();
+}
+
+void TaskGraph::schedule(int task, TaskPool &pool)
+{
+    if (_tasks[task].thread == task_main_thread)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_main_mutex);
+            _main_ready.push_back(task);
+        }
+        // Wake the thread running the graph
+        pool.notify_waiters();
+    }
+    else
+    {
+        pool.submit([this, task, &pool] { execute(task, pool); });
+    }
+}
+
+void TaskGraph::execute(int task, TaskPool &pool)
+{
+    {
+        trace_scope trace(_tasks[task].name);
+        _tasks[task].function();
+    }
+
+    // Release the tasks for which this one was the last dependency
+    for (int successor : _tasks[task].successors)
+    {
+        if (_waiting_dependencies[successor].fetch_sub(1) == 1)
+        {
+            schedule(successor, pool);
+        }
+    }
+    if (_remaining.fetch_sub(1) == 1)
+    {
+        pool.notify_waiters();
+    }
+}
+
+void TaskGraph::run(TaskPool &pool)
+{
+    const int N_task = _tasks.size();
+    _waiting_dependencies = std::make_unique<std::atomic<int>[]>(N_task);
+    _remaining = N_task;
+    _main_ready.clear();
+    for (int task = 0; task < N_task; ++task)
+    {
+        _waiting_dependencies[task] = _tasks[task].dependency_count;
+    }
+    for (int task = 0; task < N_task; ++task)
+    {
+        if (_tasks[task].dependency_count == 0)
+        {
+            schedule(task, pool);
+        }
+    }
+
+    while (_remaining.load() > 0)
+    {
+        int task = -1;
+        {
+            std::lock_guard<std::mutex> lock(_main_mutex);
+            if (!_main_ready.empty())
+            {
+                task = _main_ready.back();
+                _main_ready.pop_back();
+            }
+        }
+
+        if (task >= 0)
+        {
+            execute(task, pool);
+            continue;
+        }
+        // Help the pool until a main thread task is ready or all are done,
+        // sleeping while nothing is queued
+        pool.wait_until([this] {
+            std::lock_guard<std::mutex> lock(_main_mutex);
+            return _remaining.load() == 0 || !_main_ready.empty();
+        });
+    }
+}
+
+void TaskGraph::run_sequential()
+{
+    for (task_node &node : _tasks)
+    {
+        trace_scope trace(node.name);
+        node.function();
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "scheduling/task_pool.hpp"
+
+// Thread a task of a graph has to run on
+enum task_thread_enum
+{
+    // Any worker of the pool (or the main thread while it waits)
+    task_any_thread,
+    // The thread running the graph: the OpenGL calls must stay on the thread
+    // owning the context
+    task_main_thread
+};
+
+// Jobs of a frame and their dependencies. A task starts as soon as all the
+// tasks it depends on are done, so that independent work (the solver, the
+// preparation of the skybox, the planets...) overlaps instead of running in
+// sequence. The graph is rebuilt at each frame.
+class TaskGraph
+{
+public:
+    using task_function = std::function<void()>;
+
+    // Add a task and return its index. The name must be a string literal (it
+    // is used by the trace recorder).
+    int add(const char *name, task_function function,
+            task_thread_enum thread = task_any_thread);
+    // The task can only start once the dependency is done. A task can only
+    // depend on tasks added before it, which keeps the graph acyclic.
+    void depends_on(int task, int dependency);
+    void clear();
+    int size() const;
+
+    // Run all the tasks and return once they are done. The calling thread
+    // runs the main thread tasks, and helps the pool while none is ready.
+    void run(TaskPool &pool);
+    // Run all the tasks on the calling thread, in the order they were added
+    // (reference for debugging and single thread timings)
+    void run_sequential();
+
+private:
+    struct task_node
+    {
+        const char *name;
+        task_function function;
+        task_thread_enum thread;
+        // Number of dependencies, and tasks waiting for this one
+        int dependency_count = 0;
+        std::vector<int> successors;
+    };
+
+    void schedule(int task, TaskPool &pool);
+    void execute(int task, TaskPool &pool);
+
+    std::vector<task_node> _tasks;
+
+    // State of the current run
+    std::unique_ptr<std::atomic<int>[]> _waiting_dependencies;
+    std::atomic<int> _remaining{ 0 };
+    std::mutex _main_mutex;
+    std::vector<int> _main_ready;
+};
@@ -0,0 +1,206 @@
+#include "scheduling/task_pool.hpp"
+
+#include <algorithm>
+
+namespace
+{
+    // Pool and index of the worker running on the current thread
+    thread_local const TaskPool *current_pool = nullptr;
+    thread_local int current_worker = -1;
+} // namespace
+
+TaskPool::~TaskPool()
+{
+    stop();
+}
+
+void TaskPool::start(int worker_count)
+{
+    stop();
+    if (worker_count < 0)
+    {
+        worker_count =
+            std::max(0, int(std::thread::hardware_concurrency()) - 1);
+    }
+
+    _stopping = false;
+    // A queue is kept without any worker so that the tasks can be submitted
+    // (and run by the helping threads)
+    const int queue_count = std::max(1, worker_count);
+    for (int k = 0; k < queue_count; ++k)
+    {
+        _queues.push_back(std::make_unique<worker_queue>());
+    }
+    for (int k = 0; k < worker_count; ++k)
+    {
+        _workers.emplace_back(&TaskPool::worker_loop, this, k);
+    }
+}
+
+void TaskPool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_wake_mutex);
+        _stopping = true;
+    }
+    _wake.notify_all();
+    for (std::thread &worker : _workers)
+    {
+        worker.join();
+    }
+    _workers.clear();
+    _queues.clear();
+    _pending = 0;
+}
+
+int TaskPool::worker_count() const
+{
+    return _workers.size();
+}
+
+void TaskPool::submit(task_function task)
+{
+    // A worker keeps its tasks, the other threads spread theirs
+    const int index = current_pool == this
+        ? current_worker
+        : int(_next_queue.fetch_add(1, std::memory_order_relaxed)
+              % _queues.size());
+    // Counted before being queued: _pending never goes below the number of
+    // queued tasks
+    _pending.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(_queues[index]->mutex);
+        _queues[index]->tasks.push_back(std::move(task));
+    }
+    {
+        // Taking the lock orders the notification after the test of the
+        // waiting workers
+        std::lock_guard<std::mutex> lock(_wake_mutex);
+    }
+    _wake.notify_one();
+    // The waiting threads help with the new task
+    _waiters.notify_all();
+}
+
+bool TaskPool::pop_task(int index, task_function &task)
+{
+    const int queue_count = _queues.size();
+    for (int k = 0; k < queue_count; ++k)
+    {
+        worker_queue &queue = *_queues[(index + k) % queue_count];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty())
+        {
+            continue;
+        }
+        if (k == 0)
+        {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        else
+        {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        _pending.fetch_sub(1);
+        return true;
+    }
+    return false;
+}
+
+bool TaskPool::run_one()
+{
+    if (_queues.empty() || _pending.load() == 0)
+    {
+        return false;
+    }
+
+    task_function task;
+    const int index = current_pool == this ? current_worker : 0;
+    if (!pop_task(index, task))
+    {
+        return false;
+    }
+    task();
+    return true;
+}
+
+void TaskPool::wait_until(const std::function<bool()> &done)
+{
+    while (!done())
+    {
+        if (run_one())
+        {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(_wake_mutex);
+        _waiters.wait(lock, [&] { return done() || _pending.load() > 0; });
+    }
+}
+
+void TaskPool::notify_waiters()
+{
+    {
+        // Taking the lock orders the notification after the test of the
+        // waiting threads
+        std::lock_guard<std::mutex> lock(_wake_mutex);
+    }
+    _waiters.notify_all();
+}
+
+void TaskPool::worker_loop(int index)
+{
+    current_pool = this;
+    current_worker = index;
+
+    task_function task;
+    while (true)
+    {
+        if (pop_task(index, task))
+        {
+            task();
+            task = nullptr;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(_wake_mutex);
+        _wake.wait(lock, [this] { return _stopping || _pending.load() > 0; });
+        if (_stopping)
+        {
+            return;
+        }
+    }
+}
+
+void TaskPool::parallel_for(int count, int grain,
+                            const std::function<void(int, int)> &function)
+{
+    grain = std::max(1, grain);
+    const int block_count = (count + grain - 1) / grain;
+    if (block_count <= 1 || _queues.empty())
+    {
+        if (count > 0)
+        {
+            function(0, count);
+        }
+        return;
+    }
+
+    std::atomic<int> remaining{ block_count };
+    for (int block = 0; block < block_count; ++block)
+    {
+        const int begin = block * grain;
+        const int end = std::min(count, begin + grain);
+        submit([this, &function, &remaining, begin, end] {
+            function(begin, end);
+            if (remaining.fetch_sub(1) == 1)
+            {
+                notify_waiters();
+            }
+        });
+    }
+
+    // Help instead of waiting: the blocks may also be run by this thread
+    wait_until([&remaining] { return remaining.load() == 0; });
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Pool of worker threads running independent tasks, with work stealing:
+//  - each worker has its own queue, it runs the tasks it submits itself last
+//    in first out (their data is still in its cache),
+//  - an idle worker steals the oldest task of the queue of another one,
+//  - the other threads (the main thread) submit to the queues in turn, and
+//    help running the tasks while they wait (wait_until, parallel_for). A
+//    waiting thread sleeps while no task is queued.
+// Without any worker (single core machine) the tasks only run when a thread
+// helps, which keeps everything correct on the calling thread.
+class TaskPool
+{
+public:
+    using task_function = std::function<void()>;
+
+    TaskPool() = default;
+    ~TaskPool();
+
+    TaskPool(const TaskPool &) = delete;
+    TaskPool &operator=(const TaskPool &) = delete;
+
+    // Start the workers (by default one per core, minus the main thread)
+    void start(int worker_count = -1);
+    // Wait for the workers to finish their current task and join them (the
+    // pending tasks are dropped)
+    void stop();
+    int worker_count() const;
+
+    void submit(task_function task);
+    // Run one pending task on the calling thread, return false if there was
+    // none
+    bool run_one();
+    // Run the pending tasks on the calling thread until done() returns true,
+    // and sleep while none is pending. The thread making done() true must
+    // call notify_waiters afterwards.
+    void wait_until(const std::function<bool()> &done);
+    void notify_waiters();
+
+    // Call function(begin, end) on consecutive ranges of at most grain
+    // indices covering [0, count), on the workers and the calling thread,
+    // and return once all of them are done
+    void parallel_for(int count, int grain,
+                      const std::function<void(int, int)> &function);
+
+private:
+    struct worker_queue
+    {
+        std::mutex mutex;
+        std::deque<task_function> tasks;
+    };
+
+    void worker_loop(int index);
+    // Pop a task from the queue of the given worker (its newest task), or
+    // steal one from another queue (their oldest task)
+    bool pop_task(int index, task_function &task);
+
+    std::vector<std::unique_ptr<worker_queue>> _queues;
+    std::vector<std::thread> _workers;
+
+    // Number of tasks submitted and not started yet
+    std::atomic<int> _pending{ 0 };
+    // Queue receiving the next task submitted from outside the workers
+    std::atomic<unsigned> _next_queue{ 0 };
+    std::atomic<bool> _stopping{ false };
+    std::mutex _wake_mutex;
+    // Workers waiting for a task, and threads waiting in wait_until (woken
+    // by the tasks submitted and by notify_waiters)
+    std::condition_variable _wake;
+    std::condition_variable _waiters;
+};
@@ -0,0 +1,210 @@
+#include "simulation/barnes_hut.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace cgp;
+
+namespace
+{
+    // Deeper nodes are kept as leaves of several bodies (bodies at the same
+    // position, or extremely clustered ones)
+    constexpr int max_depth = 48;
+    // Bodies summed directly instead of split further
+    constexpr int leaf_size = 2;
+} // namespace
+
+void BarnesHutTree::build(const vec3 *positions, const float *masses,
+                          int count, StepArena &arena)
+{
+    _positions = positions;
+    _masses = masses;
+    _body_count = count;
+    _order = arena.allocate<int>(count);
+    _rank = arena.allocate<int>(count);
+    _nodes = arena.allocate<node>(std::max(1, 2 * count - 1));
+    _node_count = 0;
+    if (count == 0)
+    {
+        return;
+    }
+
+    for (int k = 0; k < count; ++k)
+    {
+        _order[k] = k;
+    }
+    node &root = _nodes[_node_count++];
+    root.first = 0;
+    root.count = count;
+    split(0, 0);
+
+    for (int k = 0; k < count; ++k)
+    {
+        _rank[_order[k]] = k;
+    }
+}
+
+void BarnesHutTree::split(int node_index, int depth)
+{
+    // Tight bounding box and center of mass of the bodies
+    node &current = _nodes[node_index];
+    const int first = current.first;
+    const int count = current.count;
+    vec3 p_min = _positions[_order[first]];
+    vec3 p_max = p_min;
+    vec3 weighted_sum = { 0, 0, 0 };
+    float mass = 0.0f;
+    for (int k = first; k < first + count; ++k)
+    {
+        const vec3 &p = _positions[_order[k]];
+        for (int c = 0; c < 3; ++c)
+        {
+            p_min[c] = std::min(p_min[c], p[c]);
+            p_max[c] = std::max(p_max[c], p[c]);
+        }
+        weighted_sum += _masses[_order[k]] * p;
+        mass += _masses[_order[k]];
+    }
+    const vec3 extent = p_max - p_min;
+    current.size = std::max(extent.x, std::max(extent.y, extent.z));
+    current.mass = mass;
+    current.center_of_mass =
+        mass > 0 ? weighted_sum / mass : (p_min + p_max) / 2.0f;
+
+    if (count <= leaf_size || depth >= max_depth || current.size == 0)
+    {
+        return;
+    }
+
+    // Counting sort of the bodies by octant of the center of the box
+    const vec3 middle = (p_min + p_max) / 2.0f;
+    auto octant = [&](int body) {
+        const vec3 &p = _positions[body];
+        return int(p.x > middle.x) | int(p.y > middle.y) << 1
+            | int(p.z > middle.z) << 2;
+    };
+    int octant_count[8] = {};
+    for (int k = first; k < first + count; ++k)
+    {
+        ++octant_count[octant(_order[k])];
+    }
+    // The middle of a box too small for the float precision may round to one
+    // of its sides: the node is kept as a leaf rather than given a single
+    // child (the 2N - 1 nodes rely on each split separating the bodies)
+    if (std::count(octant_count, octant_count + 8, count) > 0)
+    {
+        return;
+    }
+    int octant_start[8];
+    int start = first;
+    for (int o = 0; o < 8; ++o)
+    {
+        octant_start[o] = start;
+        start += octant_count[o];
+    }
+    // In place cycle sort: each body is moved to the next free slot of its
+    // octant
+    int next[8];
+    std::copy(octant_start, octant_start + 8, next);
+    for (int o = 0; o < 8; ++o)
+    {
+        while (next[o] < octant_start[o] + octant_count[o])
+        {
+            const int body = _order[next[o]];
+            const int target = octant(body);
+            if (target == o)
+            {
+                ++next[o];
+            }
+            else
+            {
+                std::swap(_order[next[o]], _order[next[target]]);
+                ++next[target];
+            }
+        }
+    }
+
+    // Children for the non empty octants (at least two, checked above)
+    current.first_child = _node_count;
+    for (int o = 0; o < 8; ++o)
+    {
+        if (octant_count[o] == 0)
+        {
+            continue;
+        }
+        node &child = _nodes[_node_count++];
+        child.first = octant_start[o];
+        child.count = octant_count[o];
+    }
+    current.child_count = _node_count - current.first_child;
+    for (int c = 0; c < current.child_count; ++c)
+    {
+        split(current.first_child + c, depth + 1);
+    }
+}
+
+vec3 BarnesHutTree::acceleration(int body, float theta, float softening,
+                                 float strength) const
+{
+    vec3 acceleration = { 0, 0, 0 };
+    if (_node_count == 0)
+    {
+        return acceleration;
+    }
+
+    const vec3 position = _positions[body];
+    const int rank = _rank[body];
+    const float softening2 = softening * softening;
+    auto attract = [&](vec3 const &center, float mass) {
+        const vec3 r = center - position;
+        const float d2 = dot(r, r) + softening2;
+        if (d2 > 0)
+        {
+            acceleration += (mass / (d2 * std::sqrt(d2))) * r;
+        }
+    };
+
+    // Depth first traversal (at most 7 siblings pending per level)
+    int stack[8 * (max_depth + 1)];
+    int stack_size = 0;
+    stack[stack_size++] = 0;
+    while (stack_size > 0)
+    {
+        const node &current = _nodes[stack[--stack_size]];
+        const bool contains_body =
+            rank >= current.first && rank < current.first + current.count;
+
+        if (!contains_body)
+        {
+            // Far enough: the whole node as a single mass
+            const vec3 r = current.center_of_mass - position;
+            const float distance = norm(r);
+            if (current.size < theta * distance)
+            {
+                attract(current.center_of_mass, current.mass);
+                continue;
+            }
+        }
+
+        if (current.child_count == 0)
+        {
+            // Leaf: direct sum over its bodies
+            for (int k = current.first; k < current.first + current.count;
+                 ++k)
+            {
+                const int other = _order[k];
+                if (other != body)
+                {
+                    attract(_positions[other], _masses[other]);
+                }
+            }
+            continue;
+        }
+
+        for (int c = 0; c < current.child_count; ++c)
+        {
+            stack[stack_size++] = current.first_child + c;
+        }
+    }
+    return strength * acceleration;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "cgp/cgp.hpp"
+#include "simulation/step_arena.hpp"
+
+// Barnes-Hut octree over point masses (the centers of mass of the shapes),
+// built in the arena of the step.
+// Each node keeps the tight bounding box of its bodies instead of a fixed
+// octant: a split always separates the bodies, so that the tree has at most
+// 2N - 1 nodes, whatever their distribution. The attraction of a node far
+// enough (size / distance < theta) is approximated by its total mass at its
+// center of mass, which makes the sum over all the bodies O(N log N).
+class BarnesHutTree
+{
+public:
+    // Build the tree of the bodies (the arrays must outlive the tree)
+    void build(const cgp::vec3 *positions, const float *masses, int count,
+               StepArena &arena);
+
+    // Acceleration of the body of the given index (its own mass excluded):
+    //   strength * sum_j m_j r_ij / (|r_ij|^2 + softening^2)^(3/2)
+    cgp::vec3 acceleration(int body, float theta, float softening,
+                           float strength) const;
+
+private:
+    struct node
+    {
+        cgp::vec3 center_of_mass;
+        float mass = 0.0f;
+        // Largest extent of the bounding box of the bodies of the node
+        float size = 0.0f;
+        // Bodies of the node: _order[first .. first + count - 1]
+        int first = 0;
+        int count = 0;
+        // Children (consecutive nodes), none for a leaf
+        int first_child = 0;
+        int child_count = 0;
+    };
+
+    // Split the bodies of the node among the octants of its bounding box
+    void split(int node_index, int depth);
+
+    const cgp::vec3 *_positions = nullptr;
+    const float *_masses = nullptr;
+    int _body_count = 0;
+    // Bodies sorted by node, and the rank of each body in this order
+    int *_order = nullptr;
+    int *_rank = nullptr;
+    node *_nodes = nullptr;
+    int _node_count = 0;
+};
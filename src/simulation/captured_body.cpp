@@ -0,0 +1,79 @@
+#include "simulation/captured_body.hpp"
+
+#include <utility>
+
+#include "profiling/profiler.hpp"
+
+using namespace cgp;
+
+void capture_black_holed_shapes(deformable_store &deformables,
+                                std::vector<captured_body_structure> &captured)
+{
+    // Backward iteration: a removal moves the last (already visited)
+    // deformable in place of the removed one
+    for (int k = int(deformables.size()) - 1; k >= 0; --k)
+    {
+        shape_deformable_structure &deformable = deformables[k];
+        if (deformable.got_black_holed.is_null())
+        {
+            continue;
+        }
+
+        captured_body_structure body;
+        body.black_hole = deformable.got_black_holed;
+        body.com_capture = center_of_mass(deformable.position);
+        body.com = body.com_capture;
+        body.shape = std::move(deformable);
+        // Normals of the frozen vertices, uploaded once by the main thread:
+        // from then on only the model transform of the drawable changes
+        body.shape.update_normals();
+        captured.push_back(std::move(body));
+
+        deformables.erase(deformables.handle_at(k));
+    }
+}
+
+void animate_captured_bodies(std::vector<captured_body_structure> &captured,
+                             const SlotMap<BlackHole> &black_holes,
+                             simulation_parameter const &param,
+                             const camera_orbit_euler &camera)
+{
+    scoped_timer timer(phase_captured_bodies);
+
+    const float dt = param.time_step;
+    for (int k = int(captured.size()) - 1; k >= 0; --k)
+    {
+        captured_body_structure &body = captured[k];
+
+        // TODO : not the actual timer in seconds...
+        body.timer += dt;
+        if (body.timer >= param.black_hole_timer)
+        {
+            captured[k] = std::move(captured.back());
+            captured.pop_back();
+            continue;
+        }
+
+        // Shrink the shape around its center of mass
+        body.scaling *= 1 - 2 * dt / param.black_hole_timer;
+
+        // Spiral around the black hole while falling into it (the shape
+        // keeps drifting if the black hole has been removed)
+        const BlackHole *black_hole = black_holes.get(body.black_hole);
+        if (black_hole != nullptr)
+        {
+            const vec3 to_black_hole = black_hole->get_center() - body.com;
+            const vec3 swirl = cross(to_black_hole, camera.position() - body.com);
+            if (norm(swirl) > 1e-6f)
+            {
+                body.com += 0.015f * normalize(swirl);
+            }
+            body.com += 0.02f * to_black_hole;
+        }
+
+        // p = com + scaling * (p_capture - com_capture)
+        body.shape.drawable.model.scaling = body.scaling;
+        body.shape.drawable.model.translation =
+            body.com - body.scaling * body.com_capture;
+    }
+}
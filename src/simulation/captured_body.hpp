@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+
+#include "simulation/simulation.hpp"
+
+// Shape captured by a black hole. It doesn't take part in the simulation
+// anymore: its vertices are frozen at the capture and the spiral toward the
+// black hole is only applied as a whole, through the model transform of its
+// drawable.
+struct captured_body_structure
+{
+    shape_deformable_structure shape;
+    // Black hole which captured the shape (may have been removed since)
+    slot_handle black_hole;
+
+    // Center of mass of the frozen vertices
+    cgp::vec3 com_capture;
+    // Current center of mass and scaling of the shape along the spiral
+    cgp::vec3 com;
+    float scaling = 1.0f;
+
+    // Time elapsed since the capture
+    float timer = 0.0f;
+
+    // Whether the frozen vertices have been uploaded to the drawable (by the
+    // main thread, see scene_structure::upload_shapes)
+    bool uploaded = false;
+};
+
+// Move the shapes marked as captured during the simulation step out of the
+// deformables, with the normals of their frozen vertices. Their drawable is
+// left to upload (no GL calls: may run on a worker thread).
+void capture_black_holed_shapes(deformable_store &deformables,
+                                std::vector<captured_body_structure> &captured);
+
+// Advance the spiral of the captured shapes toward their black hole, and
+// remove the shapes captured for longer than the black hole timer
+void animate_captured_bodies(std::vector<captured_body_structure> &captured,
+                             const SlotMap<BlackHole> &black_holes,
+                             simulation_parameter const &param,
+                             const cgp::camera_orbit_euler &camera);
@@ -0,0 +1,55 @@
+#include "simulation/physics_lod.hpp"
+
+#include <algorithm>
+
+using namespace cgp;
+
+void assign_physics_lod(deformable_store &deformables, slot_handle player,
+                        vec3 const &camera_position,
+                        simulation_parameter const &param)
+{
+    const physics_lod_parameter &lod = param.physics_lod;
+    const float dt = param.time_step;
+
+    // The player may have been removed (black hole, cleared scene)
+    const shape_deformable_structure *player_deformable =
+        deformables.get(player);
+    const vec3 player_position = player_deformable != nullptr
+        ? player_deformable->com
+        : camera_position;
+
+    const int mid_collision_steps =
+        std::max(1, std::min(lod.mid_collision_steps, param.collision_steps));
+    for (shape_deformable_structure &deformable : deformables)
+    {
+        int level = physics_lod_near;
+        if (lod.enabled)
+        {
+            const float distance =
+                std::min(norm(deformable.com - camera_position),
+                         norm(deformable.com - player_position));
+            if (distance >= lod.far_distance)
+                level = physics_lod_far;
+            else if (distance >= lod.near_distance)
+                level = physics_lod_mid;
+        }
+        deformable.physics_lod = level;
+
+        if (level == physics_lod_far
+            && deformable.skipped_steps + 1 < lod.far_tick_interval)
+        {
+            // Waiting for its next tick: left untouched by the whole step
+            ++deformable.skipped_steps;
+            deformable.step_dt = 0.0f;
+            deformable.step_iterations = 0;
+            continue;
+        }
+
+        // Integrate over the current step and the skipped ones
+        deformable.step_dt = dt * (deformable.skipped_steps + 1);
+        deformable.skipped_steps = 0;
+        deformable.step_iterations = level == physics_lod_near
+            ? param.collision_steps
+            : mid_collision_steps;
+    }
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "cgp/cgp.hpp"
+#include "simulation/simulation.hpp"
+
+// Set the level of detail of each shape for the coming simulation step, from
+// the distance of its center of mass to the nearest of the player and the
+// camera position:
+//  - near shapes are integrated at each step with all the collision steps,
+//  - mid shapes take part in at most mid_collision_steps collision steps,
+//  - far shapes are also only integrated every far_tick_interval steps, with
+//    a time step covering the skipped steps.
+// A shape coming back closer is first integrated over the steps it skipped.
+void assign_physics_lod(deformable_store &deformables, slot_handle player,
+                        cgp::vec3 const &camera_position,
+                        simulation_parameter const &param);
@@ -1,64 +1,81 @@
 #include "simulation.hpp"
 
+#include <algorithm>
+#include <cmath>
+
 #include "../../third_party/eigen/Eigen/Core"
 #include "../../third_party/eigen/Eigen/SVD"
 #include "deformable/deformable.hpp"
 #include "objects/black_hole.hpp"
 #include "objects/planet.hpp"
+#include "profiling/allocation_counter.hpp"
+#include "profiling/profiler.hpp"
+#include "profiling/trace.hpp"
+#include "simulation/barnes_hut.hpp"
+#include "simulation/physics_lod.hpp"
+#include "simulation/simulation_passes.hpp"
+#include "simulation/solver_backend.hpp"
+#include "simulation/sphere_contacts.hpp"
+#include "simulation/xpbd.hpp"
 
 #define PLAYER_CONTINUOUS_DISPLACEMENT { 0.01, 0, 0 }
 
 using namespace cgp;
 
-// Compute the polar decomposition of the matrix M and return the rotation such
-// that
-//   M = R * S, where R is a rotation matrix and S is a positive semi-definite
-//   matrix
-mat3 polar_decomposition(mat3 const &M);
-
-void planetary_attraction(std::vector<shape_deformable_structure> &deformables,
-                          const std::vector<Planet> &planets,
-                          const std::vector<BlackHole> &black_holes,
-                          simulation_parameter const &param);
-
-// Compute the collision between the particles and the walls
-void collision_with_walls(std::vector<shape_deformable_structure> &deformables);
-
-// Compute the collision between the particles and the planets
-void collision_with_planets(
-    std::vector<shape_deformable_structure> &deformables,
-    const std::vector<Planet> &planets, simulation_parameter const &param);
-
-// Compute the collision between the particles and the black_holes
-void collision_with_black_holes(
-    std::vector<shape_deformable_structure> &deformables,
-    const std::vector<BlackHole> &black_holes,
-    simulation_parameter const &param);
-
-// Compute the collision between the particles to each other
-void collision_between_particles(
-    std::vector<shape_deformable_structure> &deformables,
-    simulation_parameter const &param);
-
-// Compute the shape matching on all the deformable shapes
-void shape_matching(std::vector<shape_deformable_structure> &deformables,
-                    simulation_parameter const &param);
-
 // Perform one simulation step (one numerical integration along the time step
-// dt) using PPD + Shape Matching
-void simulation_step(std::vector<shape_deformable_structure> &deformables,
-                     const std::vector<Planet> &planets,
-                     const std::vector<BlackHole> &black_holes,
-                     simulation_parameter const &param,
-                     const cgp::camera_orbit_euler &camera)
+// dt) using PPD + Shape Matching, the passes being run by the given backend
+simulation_report simulation_step(deformable_store &deformables,
+                                  slot_handle player,
+                                  vec3 const &camera_position,
+                                  const std::vector<Planet> &planets,
+                                  const SlotMap<BlackHole> &black_holes,
+                                  simulation_parameter const &param,
+                                  SolverBackend &backend, StepArena &arena)
 {
-    float dt = param.time_step;
-    int N_deformable = deformables.size();
+    scoped_timer step_timer(phase_simulation_step);
+    const long long allocation_count_start = thread_heap_allocation_count();
+
+    // The scratch data of the previous step is not needed anymore
+    arena.reset();
+    backend.prepare(planets, black_holes, param);
 
     // Calculate the center of mass first for later use
-    for (shape_deformable_structure &deformable : deformables)
     {
-        deformable.com = average(deformable.position);
+        scoped_timer timer(phase_center_of_mass);
+        for (shape_deformable_structure &deformable : deformables)
+        {
+            deformable.com = center_of_mass(deformable.position);
+            // The positions are the predicted positions of the last step:
+            // the rotation of its last sphere tree placement is theirs
+            deformable.rest_rotation =
+                polar_decomposition(deformable.tree_placement.rotation);
+            deformable.rest_margin = -1.0f;
+            deformable.tree_placement.valid = false;
+
+            // The contacts of the pairs not tested during the last step are
+            // forgotten (shapes apart, or removed)
+            std::vector<particle_contact_cache> &contacts =
+                deformable.particle_contacts;
+            contacts.erase(
+                std::remove_if(contacts.begin(), contacts.end(),
+                               [](const particle_contact_cache &pair) {
+                                   return !pair.used;
+                               }),
+                contacts.end());
+            for (particle_contact_cache &pair : contacts)
+            {
+                pair.used = false;
+            }
+        }
+    }
+
+    // Time step and number of collision steps of each shape
+    assign_physics_lod(deformables, player, camera_position, param);
+    int max_step_iterations = 0;
+    for (const shape_deformable_structure &deformable : deformables)
+    {
+        max_step_iterations =
+            std::max(max_step_iterations, deformable.step_iterations);
     }
 
     // I. - Apply the external forces to the velocity
@@ -82,86 +99,157 @@ void simulation_step(std::vector<shape_deformable_structure> &deformables,
     //     }
     // }
 
-    // I. bis -> planet attraction instead of gravity
-    planetary_attraction(deformables, planets, black_holes, param);
+    // I. bis -> planet attraction instead of gravity (and the attraction of
+    // the other shapes in N-body mode)
+    backend.mutual_gravity(deformables, param, arena);
+    backend.planetary_attraction(deformables, planets, black_holes, param);
+
+    // I. ter -> stop the particles crossing a planet during the time step
+    if (param.continuous_collision)
+    {
+        continuous_collision(deformables, planets, black_holes, param);
+    }
 
-    // II. Constraints using PPD
+    // II. Constraints using PPD (or XPBD)
     //     - Collision with the walls (particles/walls)
     //     - Collision between particles (particles/particles)
     //     - Apply shape matching (per shape)
     // Note: The parameter collision_steps can be modified by the gui interface
-    for (int k_collision_steps = 0; k_collision_steps < param.collision_steps;
+    // In adaptive mode, collision_steps is the maximum number of iterations:
+    // the loop stops as soon as the largest correction of an iteration falls
+    // below the tolerance (after min_collision_steps iterations)
+    bounding_box *bbox = arena.allocate<bounding_box>(deformables.size());
+    const bool xpbd = param.solver == solver_xpbd;
+    xpbd_multipliers lambda;
+    if (xpbd)
+    {
+        lambda = xpbd_multipliers::allocate(deformables, arena);
+    }
+    simulation_report report;
+    const int min_collision_steps =
+        std::min(param.min_collision_steps, max_step_iterations);
+    for (int k_collision_steps = 0; k_collision_steps < max_step_iterations;
          ++k_collision_steps)
     {
+        trace_scope trace("collision_iteration");
+
+        // The shapes past their number of collision steps (or skipped by this
+        // step) are left as they are
+        for (shape_deformable_structure &deformable : deformables)
+        {
+            deformable.solving = k_collision_steps < deformable.step_iterations;
+        }
+
+        // Largest penetration or shape matching displacement corrected during
+        // this iteration
+        float residual = 0.0f;
+
         // collision_with_walls(deformables);
-        collision_between_particles(deformables, param);
-        collision_with_planets(deformables, planets, param);
-        collision_with_black_holes(deformables, black_holes, param);
-        shape_matching(deformables, param);
+        compute_bounding_boxes(deformables, param, bbox);
+        // Contacts between particles are kept as hard constraints in both
+        // solvers (zero compliance: no multiplier needed)
+        residual = std::max(residual, backend.collision_between_particles(
+                                          deformables, bbox, param));
+        if (xpbd)
+        {
+            residual = std::max(residual,
+                                collision_with_planets_xpbd(
+                                    deformables, bbox, planets, param, lambda));
+        }
+        else
+        {
+            residual = std::max(residual, backend.collision_with_planets(
+                                              deformables, bbox, planets,
+                                              param, arena));
+        }
+        backend.collision_with_black_holes(deformables, bbox, black_holes,
+                                           param);
+        if (xpbd)
+        {
+            residual = std::max(residual,
+                                shape_matching_xpbd(deformables, param, lambda));
+        }
+        else
+        {
+            residual = std::max(residual,
+                                backend.shape_matching(deformables, param));
+        }
+
+        report.iterations = k_collision_steps + 1;
+        report.residual = residual;
+        if (param.adaptive_iterations
+            && report.iterations >= min_collision_steps
+            && residual < param.residual_tolerance)
+        {
+            break;
+        }
     }
+    profiler.add_count(counter_solver_iterations, report.iterations);
 
     // III. Final velocity update
-    for (int kd = 0; kd < N_deformable; ++kd)
-    {
-        shape_deformable_structure &deformable = deformables[kd];
+    // The shapes captured by a black hole during this step leave the
+    // simulation afterwards (see capture_black_holed_shapes)
+    backend.update_velocity(deformables, param);
 
-        const cgp::mat4 scaling_transform = mat4::build_identity().
-                                            apply_translation(-deformable.com).
-                                            apply_scaling(
-                                                1 - 2 * dt / param.black_hole_timer)
-                                            .apply_translation(deformable.com);
+    // FIXME: try to move the player forward on the planet
+    move_player(deformables, player, planets);
 
-        // Got black holed -> spiral animation
-        if (deformable.got_black_holed != nullptr)
-        {
-            const BlackHole *black_hole = deformable.got_black_holed;
-            const vec3 to_black_hole_vec = black_hole->get_center() - deformable
-                .com;
+    profiler.add_count(counter_heap_allocations,
+                       thread_heap_allocation_count() - allocation_count_start);
+    return report;
+}
 
-            for (int k = 0; k < deformable.size(); ++k)
-            {
-                deformable.position[k] = (scaling_transform * vec4(
-                    deformable.position[k], 1.0)).xyz();
-
-                // Update velocity
-                deformable.velocity[k] =
-                    cgp::cross(to_black_hole_vec,
-                               (camera.position() - deformable.position[k])) /
-                    dt;
-
-                // Update the vertex position
-                deformable.position[k] += 0.015 *
-                    cgp::normalize(deformable.
-                        velocity[k]) +
-                    to_black_hole_vec * 0.02;
-            }
+// Update the velocity and the position from the predicted position
+void update_velocity(deformable_store &deformables,
+                     simulation_parameter const &)
+{
+    scoped_timer timer(phase_velocity_update);
+    update_velocity_range(deformables, 0, deformables.size());
+}
 
-            deformable.dt_timer += dt;
+void update_velocity_range(deformable_store &deformables, int begin, int end)
+{
+    for (int kd = begin; kd < end; ++kd)
+    {
+        shape_deformable_structure &deformable = deformables[kd];
+        const float dt = deformable.step_dt;
+        if (dt == 0)
+        {
+            continue;
         }
-        else
+
+        for (int k = 0; k < deformable.size(); ++k)
         {
-            // Normal update of the velocity
-            for (int k = 0; k < deformable.size(); ++k)
-            {
-                // Update velocity
-                deformable.velocity[k] =
-                    (deformable.position_predict[k] - deformable.position[k]) /
-                    dt;
+            // Update velocity
+            deformable.velocity[k] =
+                (deformable.position_predict[k] - deformable.position[k]) /
+                dt;
 
-                // Update the vertex position
-                deformable.position[k] = deformable.position_predict[k];
-            }
+            // Update the vertex position
+            deformable.position[k] = deformable.position_predict[k];
         }
     }
+}
 
-    // FIXME: try to move the player forward on the planet
+// Move the player along the surface of the planet attracting it
+void move_player(deformable_store &deformables, slot_handle player,
+                 const std::vector<Planet> &planets)
+{
+    scoped_timer timer(phase_player_displacement);
+
+    // The player may have been removed (black hole, cleared scene)
+    shape_deformable_structure *player_deformable = deformables.get(player);
+    if (player_deformable == nullptr)
+    {
+        return;
+    }
 
     for (const Planet &planet : planets)
     {
-        if (planet.should_attract_deformable(deformables[0]))
+        if (planet.should_attract_deformable(*player_deformable))
         {
             cgp::vec3 normal = cgp::normalize(
-                deformables[0].com - planet.get_center());
+                player_deformable->com - planet.get_center());
             cgp::vec3 movement = PLAYER_CONTINUOUS_DISPLACEMENT;
             float movement_amplitude = std::sqrt(
                 cgp::dot(movement, movement));
@@ -169,18 +257,18 @@ void simulation_step(std::vector<shape_deformable_structure> &deformables,
 
             cgp::vec3 displacement = direction * movement_amplitude;
 
-            deformables[0].com += displacement * direction;
-            for (int k = 0; k < deformables[0].position.size(); k++)
+            player_deformable->com += displacement * direction;
+            for (int k = 0; k < player_deformable->position.size(); k++)
             {
-                deformables[0].position[k] += displacement;
+                player_deformable->position[k] += displacement;
             }
         }
     }
 }
 
 // Compute the shape matching on all the deformable shapes
-void shape_matching(std::vector<shape_deformable_structure> &deformables,
-                    simulation_parameter const &param)
+float shape_matching(deformable_store &deformables,
+                     simulation_parameter const &param)
 {
     // Arguments:
     //   deformables: stores a vector of all the deformable shape
@@ -219,15 +307,35 @@ void shape_matching(std::vector<shape_deformable_structure> &deformables,
     //  product. It can be computed using the syntax "mat3 M =
     //  tensor_product(a,b)"
     //
-    for (shape_deformable_structure &deformable : deformables)
+    scoped_timer timer(phase_shape_matching);
+    return shape_matching_range<generic_step_policy>(
+        deformables, 0, deformables.size(), param);
+}
+
+template <typename Policy>
+float shape_matching_range(deformable_store &deformables, int begin, int end,
+                           simulation_parameter const &param)
+{
+    const float stiffness = 1 - param.elasticity;
+    // Largest squared displacement (a single square root at the end)
+    float max_displacement2 = 0.0f;
+    for (int kd = begin; kd < end; ++kd)
     {
-        if (deformable.got_black_holed != nullptr)
+        shape_deformable_structure &deformable = deformables[kd];
+        if (!deformable.solving)
         {
             continue;
         }
+        if constexpr (Policy::black_holes)
+        {
+            if (!deformable.got_black_holed.is_null())
+                continue;
+        }
 
-        deformable.com = average(deformable.position_predict);
-        deformable.com_reference = average(deformable.position);
+        // Largest squared distance left between a particle and its goal
+        float goal_distance2 = 0.0f;
+        deformable.com = center_of_mass(deformable.position_predict);
+        deformable.com_reference = center_of_mass(deformable.position);
         mat3 T = mat3::build_zero();
         for (int i = 0; i < deformable.position_predict.size(); i++)
         {
@@ -241,29 +349,371 @@ void shape_matching(std::vector<shape_deformable_structure> &deformables,
             auto new_pred =
                 R * (deformable.position[i] - deformable.com_reference)
                 + deformable.com;
-            deformable.position_predict[i] =
-                param.elasticity * deformable.position_predict[i]
-                + (1 - param.elasticity) * new_pred;
+            vec3 displacement = new_pred - deformable.position_predict[i];
+            // The rigid shapes reach their goal: no blend
+            if constexpr (!Policy::rigid)
+            {
+                displacement = stiffness * displacement;
+            }
+            deformable.position_predict[i] += displacement;
+            max_displacement2 =
+                std::max(max_displacement2, dot(displacement, displacement));
+            if constexpr (!Policy::rigid)
+            {
+                const vec3 to_goal = new_pred - deformable.position_predict[i];
+                goal_distance2 =
+                    std::max(goal_distance2, dot(to_goal, to_goal));
+            }
         }
+        place_sphere_tree(deformable, R, std::sqrt(goal_distance2));
     }
+    return std::sqrt(max_displacement2);
 }
 
-void collision_between_particles(
-    std::vector<shape_deformable_structure> &deformables,
-    simulation_parameter const &param)
+// Largest distance of the given positions of the shape to its reference shape
+// placed by the rotation and the center
+static float placement_margin(const numarray<vec3> &positions,
+                              const shape_deformable_structure &deformable,
+                              mat3 const &rotation, vec3 const &center)
 {
-    float r = param.collision_radius; // radius of colliding sphere
+    float margin2 = 0.0f;
+    for (int k = 0; k < positions.size(); ++k)
+    {
+        const vec3 d = positions[k] - center
+            - rotation * (deformable.position_reference[k]
+                          - deformable.com_rest);
+        margin2 = std::max(margin2, dot(d, d));
+    }
+    return std::sqrt(margin2);
+}
 
-    // Prepare acceleration structure using axis-aligned bounding boxes.
-    std::vector<bounding_box> bbox;
-    int N_deformable = deformables.size();
+void place_sphere_tree(shape_deformable_structure &deformable, mat3 const &R,
+                       float goal_distance)
+{
+    sphere_tree_placement &placement = deformable.tree_placement;
+    if (deformable.sphere_tree.empty())
+    {
+        return;
+    }
+
+    // The positions do not move during the step: their distance to the
+    // rotated reference shape is measured once
+    if (deformable.rest_margin < 0)
+    {
+        deformable.rest_margin =
+            placement_margin(deformable.position, deformable,
+                             deformable.rest_rotation,
+                             deformable.com_reference);
+    }
+
+    // The goal of the vertex k, R (p_k - com_reference) + com, is within
+    // rest_margin of R rest_rotation (p_reference_k - com_rest) + com, and the
+    // predicted position within goal_distance of its goal
+    placement.rotation = R * deformable.rest_rotation;
+    placement.center = deformable.com;
+    placement.margin = deformable.rest_margin + goal_distance;
+    placement.valid = true;
+}
+
+// Place the sphere tree of the shape by measuring its predicted positions
+static void measure_sphere_tree_placement(
+    shape_deformable_structure &deformable)
+{
+    sphere_tree_placement &placement = deformable.tree_placement;
+    placement.center = center_of_mass(deformable.position_predict);
+    placement.rotation = deformable.rest_rotation;
+    placement.margin =
+        placement_margin(deformable.position_predict, deformable,
+                         placement.rotation, placement.center);
+    placement.valid = true;
+
+    // Placement far from the shape (rotation drifted during a large
+    // deformation): fit a new rotation
+    if (placement.margin > 0.25f * deformable.sphere_tree.nodes()[0].radius)
+    {
+        mat3 T = mat3::build_zero();
+        for (int k = 0; k < deformable.size(); ++k)
+        {
+            T += tensor_product(deformable.position_predict[k]
+                                    - placement.center,
+                                deformable.position_reference[k]
+                                    - deformable.com_rest);
+        }
+        placement.rotation = polar_decomposition(T);
+        placement.margin =
+            placement_margin(deformable.position_predict, deformable,
+                             placement.rotation, placement.center);
+        // The rest margin measured with the former rotation is remeasured by
+        // the next shape matching
+        deformable.rest_rotation = placement.rotation;
+        deformable.rest_margin = -1.0f;
+    }
+}
+
+void compute_bounding_boxes(deformable_store &deformables,
+                            simulation_parameter const &param,
+                            bounding_box *bbox)
+{
+    scoped_timer timer(phase_bounding_boxes);
+
+    const float r = param.collision_radius; // radius of colliding sphere
+    const int N_deformable = deformables.size();
     for (int kd = 0; kd < N_deformable; ++kd)
     {
-        bounding_box b;
-        b.initialize(deformables[kd].position_predict);
-        b.extends(r);
-        bbox.push_back(b);
+        shape_deformable_structure &deformable = deformables[kd];
+        const SphereTree &tree = deformable.sphere_tree;
+        if (tree.empty())
+        {
+            bbox[kd].initialize(deformable.position_predict);
+            bbox[kd].extends(r);
+            continue;
+        }
+
+        // The shape matching of the last iteration placed the tree, except
+        // at the first iteration of the step
+        sphere_tree_placement &placement = deformable.tree_placement;
+        if (!placement.valid || !deformable.got_black_holed.is_null())
+        {
+            measure_sphere_tree_placement(deformable);
+        }
+
+        // Bounding box of the rotated reference box, enlarged by the margin
+        const mat3 &R = placement.rotation;
+        const vec3 &h = tree.box_half_size();
+        const vec3 center = placement.center + R * tree.box_center();
+        for (int c = 0; c < 3; ++c)
+        {
+            const float half = std::abs(R(c, 0)) * h.x
+                + std::abs(R(c, 1)) * h.y + std::abs(R(c, 2)) * h.z
+                + placement.margin + r;
+            bbox[kd].p_min[c] = center[c] - half;
+            bbox[kd].p_max[c] = center[c] + half;
+        }
+    }
+}
+
+// Bound of the distance moved by the particles of the shape from a placement
+// of its sphere tree to another one
+static float placement_motion(const shape_deformable_structure &deformable,
+                              const sphere_tree_placement &from,
+                              const sphere_tree_placement &to)
+{
+    // |R' q + c' - R q - c| <= |c' - c| + |R' - R| |q|, the Frobenius norm
+    // of R' - R bounding its spectral norm
+    float rotation_change2 = 0.0f;
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            const float d = to.rotation(i, j) - from.rotation(i, j);
+            rotation_change2 += d * d;
+        }
+    }
+    return norm(to.center - from.center)
+        + std::sqrt(rotation_change2) * deformable.sphere_tree.extent()
+        + from.margin + to.margin;
+}
+
+// Resolve the contacts between the particles of two shapes, descending their
+// sphere trees down to the pairs of leaves whose spheres overlap. The left
+// particle of a contact receives left_share of its correction, the right one
+// the rest. The pairs of particles closer than the contact distance plus the
+// skin are added to the cache, if any.
+// The margins of the placements of the trees grow by the corrections, so that
+// they still bound the particles for the next passes and the caches.
+static float collide_particles(shape_deformable_structure &left,
+                               shape_deformable_structure &right, float r,
+                               float left_share, float skin,
+                               particle_contact_cache *cache,
+                               long long &sphere_tests,
+                               long long &vertex_pair_tests,
+                               long long &contacts_resolved)
+{
+    const std::vector<SphereTree::node> &left_nodes = left.sphere_tree.nodes();
+    const std::vector<SphereTree::node> &right_nodes =
+        right.sphere_tree.nodes();
+    if (left_nodes.empty() || right_nodes.empty())
+    {
+        return 0.0f;
+    }
+    const std::vector<int> &left_vertices = left.sphere_tree.vertices();
+    const std::vector<int> &right_vertices = right.sphere_tree.vertices();
+    const sphere_tree_placement &left_placement = left.tree_placement;
+    const sphere_tree_placement &right_placement = right.tree_placement;
+    const float contact_distance =
+        2 * r + skin + left_placement.margin + right_placement.margin;
+    const float max_share = std::max(left_share, 1 - left_share);
+
+    // Pairs of nodes to visit: a pair adds at most two pairs one level
+    // deeper, and the balanced trees are less than 32 levels deep
+    constexpr int max_stack = 128;
+    int stack[max_stack][2];
+    int stack_size = 0;
+    stack[stack_size][0] = 0;
+    stack[stack_size++][1] = 0;
+    float max_correction = 0.0f;
+    while (stack_size > 0)
+    {
+        --stack_size;
+        const int a = stack[stack_size][0];
+        const int b = stack[stack_size][1];
+        const SphereTree::node &node_a = left_nodes[a];
+        const SphereTree::node &node_b = right_nodes[b];
+        ++sphere_tests;
+        const vec3 center_a =
+            left_placement.center + left_placement.rotation * node_a.center;
+        const vec3 center_b =
+            right_placement.center + right_placement.rotation * node_b.center;
+        const vec3 ab = center_b - center_a;
+        const float reach = node_a.radius + node_b.radius + contact_distance;
+        if (dot(ab, ab) >= reach * reach)
+        {
+            continue;
+        }
+
+        const bool leaf_a = node_a.first_child == 0;
+        const bool leaf_b = node_b.first_child == 0;
+        if (leaf_a && leaf_b)
+        {
+            vertex_pair_tests += (long long)node_a.count * node_b.count;
+            for (int ka = node_a.first; ka < node_a.first + node_a.count;
+                 ++ka)
+            {
+                vec3 &p_left = left.position_predict[left_vertices[ka]];
+                for (int kb = node_b.first;
+                     kb < node_b.first + node_b.count; ++kb)
+                {
+                    vec3 &p_right = right.position_predict[right_vertices[kb]];
+                    auto n = norm(p_left - p_right);
+                    if (cache != nullptr && n < 2 * r + skin)
+                    {
+                        cache->particles.push_back(left_vertices[ka]);
+                        cache->other_particles.push_back(right_vertices[kb]);
+                        cache->normals.push_back(
+                            n > 0 ? (p_right - p_left) / n : vec3(0, 0, 1));
+                    }
+                    if (n < 2 * r)
+                    {
+                        vec3 left_to_right = (p_right - p_left) / n;
+                        float d = 2 * r - n;
+                        p_left -= left_to_right * d * left_share;
+                        p_right += left_to_right * d * (1 - left_share);
+                        left.tree_placement.margin += d * left_share;
+                        right.tree_placement.margin += d * (1 - left_share);
+                        max_correction =
+                            std::max(max_correction, d * max_share);
+                        ++contacts_resolved;
+                    }
+                }
+            }
+        }
+        // Descend into the larger sphere
+        else if (leaf_b || (!leaf_a && node_a.radius >= node_b.radius))
+        {
+            stack[stack_size][0] = node_a.first_child;
+            stack[stack_size++][1] = b;
+            stack[stack_size][0] = node_a.first_child + 1;
+            stack[stack_size++][1] = b;
+        }
+        else
+        {
+            stack[stack_size][0] = a;
+            stack[stack_size++][1] = node_b.first_child;
+            stack[stack_size][0] = a;
+            stack[stack_size++][1] = node_b.first_child + 1;
+        }
+    }
+    return max_correction;
+}
+
+// Resolve the contacts between the particles of two shapes from their pairs
+// of particles cached by the last search, or search them again if the shapes
+// have moved too much since
+static float collide_cached_particles(shape_deformable_structure &left,
+                                      shape_deformable_structure &right,
+                                      slot_handle right_handle, float r,
+                                      float left_share, float skin,
+                                      long long &sphere_tests,
+                                      long long &vertex_pair_tests,
+                                      long long &contacts_resolved,
+                                      long long &contact_searches)
+{
+    particle_contact_cache *cache = nullptr;
+    for (particle_contact_cache &pair : left.particle_contacts)
+    {
+        if (pair.other == right_handle)
+        {
+            cache = &pair;
+            break;
+        }
+    }
+    if (cache == nullptr)
+    {
+        left.particle_contacts.emplace_back();
+        cache = &left.particle_contacts.back();
+        cache->other = right_handle;
+    }
+    cache->used = true;
+
+    if (!cache->placement.valid || !cache->other_placement.valid
+        || placement_motion(left, cache->placement, left.tree_placement)
+                + placement_motion(right, cache->other_placement,
+                                   right.tree_placement)
+            > skin)
+    {
+        ++contact_searches;
+        cache->particles.clear();
+        cache->other_particles.clear();
+        cache->normals.clear();
+        const float correction = collide_particles(
+            left, right, r, left_share, skin, cache, sphere_tests,
+            vertex_pair_tests, contacts_resolved);
+        // Placements after the search: their margins include its corrections
+        cache->placement = left.tree_placement;
+        cache->other_placement = right.tree_placement;
+        return correction;
+    }
+
+    const float max_share = std::max(left_share, 1 - left_share);
+    float max_correction = 0.0f;
+    const int N_pair = cache->particles.size();
+    vertex_pair_tests += N_pair;
+    for (int k = 0; k < N_pair; ++k)
+    {
+        vec3 &p_left = left.position_predict[cache->particles[k]];
+        vec3 &p_right = right.position_predict[cache->other_particles[k]];
+        const float n = norm(p_right - p_left);
+        if (n < 2 * r)
+        {
+            // Coinciding particles are separated along their last direction
+            if (n > 1e-6f)
+            {
+                cache->normals[k] = (p_right - p_left) / n;
+            }
+            const vec3 left_to_right = cache->normals[k];
+            const float d = 2 * r - n;
+            p_left -= left_to_right * d * left_share;
+            p_right += left_to_right * d * (1 - left_share);
+            left.tree_placement.margin += d * left_share;
+            right.tree_placement.margin += d * (1 - left_share);
+            max_correction = std::max(max_correction, d * max_share);
+            ++contacts_resolved;
+        }
     }
+    return max_correction;
+}
+
+float collision_between_particles(
+    deformable_store &deformables,
+    const bounding_box *bbox, simulation_parameter const &param)
+{
+    scoped_timer timer(phase_collision_particles);
+
+    float r = param.collision_radius; // radius of colliding sphere
+
+    // The acceleration structure using axis-aligned bounding boxes (and the
+    // placement of the sphere trees) is prepared once per iteration by
+    // compute_bounding_boxes.
     // Can test if two bounding box (bbox1,bbox2) collide using
     //   bool is_in_collision = bounding_box::collide(bbox1, bbox2);
     // These bounding box are an optional possibility to accelerate the
@@ -280,126 +730,242 @@ void collision_between_particles(
     //    - For all the vertices(/particles) of the shapes (p_i,p_j)
     //      - If ||p_i-p_j|| < 2 r // collision state
     //           Then modify (p_i,p_j) to remove the collision state
+    long long bbox_tests = 0;
+    long long sphere_tests = 0;
+    long long vertex_pair_tests = 0;
+    long long contacts_resolved = 0;
+    long long contact_searches = 0;
+    const contact_cache_parameter &contact_cache = param.contact_cache;
+    float max_correction = 0.0f;
     for (int i = 0; i < deformables.size(); i++)
     {
         for (int j = 0; j < i; j++)
         {
             auto &left_deformable = deformables[i];
             auto &right_deformable = deformables[j];
+            // A shape not solved in this iteration is static: the whole
+            // correction goes to the other one
+            if (!left_deformable.solving && !right_deformable.solving)
+            {
+                continue;
+            }
+            float left_share = 0.5f;
+            if (!right_deformable.solving)
+            {
+                left_share = 1.0f;
+            }
+            else if (!left_deformable.solving)
+            {
+                left_share = 0.0f;
+            }
+            ++bbox_tests;
             if (bounding_box::collide(bbox[i], bbox[j]))
             {
-                // objects MAY collide
-                for (auto &p_left : left_deformable.position_predict)
+                // objects MAY collide: only the vertices of overlapping
+                // leaves of their sphere trees are tested
+                float correction;
+                if (contact_cache.enabled)
                 {
-                    for (auto &p_right : right_deformable.position_predict)
-                    {
-                        auto n = norm(p_left - p_right);
-                        if (n < 2 * r)
-                        {
-                            vec3 left_to_right = (p_right - p_left) / n;
-                            float d = 2 * r - n;
-                            p_left -= left_to_right * d / 2;
-                            p_right += left_to_right * d / 2;
-                        }
-                    }
+                    correction = collide_cached_particles(
+                        left_deformable, right_deformable,
+                        deformables.handle_at(j), r, left_share,
+                        contact_cache.skin,
+                        sphere_tests, vertex_pair_tests, contacts_resolved,
+                        contact_searches);
                 }
+                else
+                {
+                    correction = collide_particles(
+                        left_deformable, right_deformable, r, left_share,
+                        0.0f, nullptr,
+                        sphere_tests, vertex_pair_tests, contacts_resolved);
+                }
+                max_correction = std::max(max_correction, correction);
             }
         }
     }
+
+    profiler.add_count(counter_bbox_tests, bbox_tests);
+    profiler.add_count(counter_sphere_tests, sphere_tests);
+    profiler.add_count(counter_contact_searches, contact_searches);
+    profiler.add_count(counter_vertex_pair_tests, vertex_pair_tests);
+    profiler.add_count(counter_contacts_resolved, contacts_resolved);
+    return max_correction;
 }
 
-void collision_with_planets(
-    std::vector<shape_deformable_structure> &deformables,
-    const std::vector<Planet> &planets, simulation_parameter const &param)
+// Keep the planets touching the shape and its particles within the skin of
+// one of them, for the next iterations and steps
+static void cache_planet_contacts(shape_deformable_structure &deformable,
+                                  const bounding_box &bbox,
+                                  const std::vector<Planet> &planets,
+                                  const sphere_collider *touching,
+                                  int N_touching, float skin)
 {
-    const float r = param.collision_radius; // radius of colliding sphere
-
-    // Prepare acceleration structure using axis-aligned bounding boxes.
-    std::vector<bounding_box> bbox;
-    const int N_deformable = deformables.size();
-    for (int kd = 0; kd < N_deformable; ++kd)
+    planet_contact_cache &cache = deformable.planet_contacts;
+    // The contacts with the planets have just moved the particles: the margin
+    // is measured on the positions the particles are selected from
+    cache.placement = deformable.tree_placement;
+    if (!deformable.sphere_tree.empty())
     {
-        bounding_box b;
-        b.initialize(deformables[kd].position_predict);
-        b.extends(r);
-        bbox.push_back(b);
+        cache.placement.margin =
+            placement_margin(deformable.position_predict, deformable,
+                             cache.placement.rotation, cache.placement.center);
     }
-
-    std::vector<bounding_box> planet_bbox;
-    const int N_planet = planets.size();
-    for (int kp = 0; kp < N_planet; ++kp)
+    cache.planets.clear();
+    for (int j = 0; j < planets.size(); ++j)
     {
-        bounding_box b;
+        if (bounding_box::collide(bbox, planets[j].get_bounding_box()))
+        {
+            cache.planets.push_back(j);
+        }
+    }
 
-        b.initialize(planets[kp].get_mesh().position);
-        // offset the bounding box with the position of the planet
-        b.p_min += planets[kp].get_center();
-        b.p_max += planets[kp].get_center();
-        b.extends(2 * planets[kp].get_radius());
-        planet_bbox.push_back(b);
+    cache.particles.clear();
+    for (int k = 0; k < deformable.size(); ++k)
+    {
+        const vec3 &p = deformable.position_predict[k];
+        for (int t = 0; t < N_touching; ++t)
+        {
+            const vec3 d = p - touching[t].center;
+            const float reach = touching[t].radius + skin;
+            if (dot(d, d) < reach * reach)
+            {
+                cache.particles.push_back(k);
+                break;
+            }
+        }
     }
+}
 
-    for (int i = 0; i < N_deformable; i++)
+float collision_with_planets(
+    deformable_store &deformables,
+    const bounding_box *bbox, const std::vector<Planet> &planets,
+    simulation_parameter const &param, StepArena &arena)
+{
+    scoped_timer timer(phase_collision_planets);
+
+    // Planets whose bounding box overlaps the current deformable
+    sphere_collider *touching =
+        arena.allocate<sphere_collider>(planets.size());
+    return collision_with_planets_range(deformables, 0, deformables.size(),
+                                        bbox, planets, param, touching,
+                                        resolve_sphere_contacts);
+}
+
+float collision_with_planets_range(
+    deformable_store &deformables, int begin, int end,
+    const bounding_box *bbox, const std::vector<Planet> &planets,
+    simulation_parameter const &param, sphere_collider *touching,
+    sphere_contact_function resolve_contacts)
+{
+    const float r = param.collision_radius; // radius of colliding sphere
+    const int N_planet = planets.size();
+    const contact_cache_parameter &contact_cache = param.contact_cache;
+
+    long long bbox_tests = 0;
+    long long vertex_pair_tests = 0;
+    long long contacts_resolved = 0;
+    long long contact_searches = 0;
+    float max_correction = 0.0f;
+    for (int i = begin; i < end; i++)
     {
+        auto &deformable = deformables[i];
+        if (!deformable.solving)
+        {
+            continue;
+        }
+
+        // The particles of the last search hold while the shape has moved by
+        // less than the skin, and no other planet touches it
+        planet_contact_cache &cache = deformable.planet_contacts;
+        bool cached = contact_cache.enabled && cache.placement.valid
+            && placement_motion(deformable, cache.placement,
+                                deformable.tree_placement)
+                <= contact_cache.skin;
+        int N_touching = 0;
         for (int j = 0; j < N_planet; j++)
         {
-            auto &deformable = deformables[i];
             auto &planet = planets[j];
-            const auto planet_r = planet.get_radius();
-            const auto planet_center = planet.get_center();
 
-            if (bounding_box::collide(bbox[i], planet_bbox[j]))
+            ++bbox_tests;
+            if (bounding_box::collide(bbox[i], planet.get_bounding_box()))
             {
                 // objects MAY collide
-                for (auto &deformable_position : deformable.position_predict)
-                {
-                    vec3 to_planet = planet_center - deformable_position;
-                    auto n = norm(to_planet);
-                    if (n < r + planet_r)
-                    {
-                        deformable_position -=
-                            normalize(to_planet) * ((r + planet_r) - n);
-                    }
-                }
+                touching[N_touching].center = planet.get_center();
+                touching[N_touching].radius = r + planet.get_radius();
+                ++N_touching;
+                cached = cached
+                    && std::find(cache.planets.begin(), cache.planets.end(),
+                                 j)
+                        != cache.planets.end();
+            }
+        }
+        if (N_touching == 0)
+        {
+            continue;
+        }
+
+        if (cached)
+        {
+            // Only the particles close to the planets are pushed out
+            const int N_particle = cache.particles.size();
+            cache.positions.resize(N_particle);
+            for (int k = 0; k < N_particle; ++k)
+            {
+                cache.positions[k] =
+                    deformable.position_predict[cache.particles[k]];
             }
+            vertex_pair_tests += (long long)N_particle * N_touching;
+            max_correction = std::max(
+                max_correction,
+                resolve_contacts(cache.positions, touching, N_touching,
+                                 contacts_resolved));
+            for (int k = 0; k < N_particle; ++k)
+            {
+                deformable.position_predict[cache.particles[k]] =
+                    cache.positions[k];
+            }
+            continue;
+        }
+
+        vertex_pair_tests += (long long)deformable.size() * N_touching;
+        max_correction = std::max(
+            max_correction,
+            resolve_contacts(deformable.position_predict, touching,
+                             N_touching, contacts_resolved));
+        if (contact_cache.enabled)
+        {
+            ++contact_searches;
+            cache_planet_contacts(deformable, bbox[i], planets, touching,
+                                  N_touching, contact_cache.skin);
         }
     }
+
+    profiler.add_count(counter_bbox_tests, bbox_tests);
+    profiler.add_count(counter_contact_searches, contact_searches);
+    profiler.add_count(counter_vertex_pair_tests, vertex_pair_tests);
+    profiler.add_count(counter_contacts_resolved, contacts_resolved);
+    return max_correction;
 }
 
 
 void collision_with_black_holes(
-    std::vector<shape_deformable_structure> &deformables,
-    const std::vector<BlackHole> &black_holes,
+    deformable_store &deformables,
+    const bounding_box *bbox, const SlotMap<BlackHole> &black_holes,
     simulation_parameter const &param)
 {
-    const float r = param.collision_radius; // radius of colliding sphere
+    scoped_timer timer(phase_collision_black_holes);
 
-    // Prepare acceleration structure using axis-aligned bounding boxes.
-    std::vector<bounding_box> bbox;
+    const float r = param.collision_radius; // radius of colliding sphere
     const int N_deformable = deformables.size();
-    for (int kd = 0; kd < N_deformable; ++kd)
-    {
-        bounding_box b;
-        b.initialize(deformables[kd].position_predict);
-        b.extends(r);
-        bbox.push_back(b);
-    }
-
-    std::vector<bounding_box> black_hole_bbox;
     const int N_black_hole = black_holes.size();
-    for (int kp = 0; kp < N_black_hole; ++kp)
-    {
-        bounding_box b;
-
-        b.initialize(numarray<vec3>({ black_holes[kp].get_center() }));
-        // offset the bounding box with the position of the black_hole
-        b.extends(2 * black_holes[kp].get_radius());
-        black_hole_bbox.push_back(b);
-    }
 
+    long long bbox_tests = 0;
+    long long vertex_pair_tests = 0;
     for (int i = 0; i < N_deformable; i++)
     {
-        if (deformables[i].got_black_holed != nullptr)
+        if (!deformables[i].solving
+            || !deformables[i].got_black_holed.is_null())
         {
             continue;
         }
@@ -411,9 +977,12 @@ void collision_with_black_holes(
             const auto black_hole_r = black_hole.get_radius();
             const auto black_hole_center = black_hole.get_center();
 
-            if (bounding_box::collide(bbox[i], black_hole_bbox[j]))
+            ++bbox_tests;
+            if (bounding_box::collide(bbox[i],
+                                      black_hole.get_bounding_box()))
             {
                 // objects MAY collide
+                vertex_pair_tests += deformable.size();
                 for (auto &deformable_position : deformable.position_predict)
                 {
                     vec3 to_black_hole = black_hole_center -
@@ -421,17 +990,135 @@ void collision_with_black_holes(
                     auto n = norm(to_black_hole);
                     if (n < r + black_hole_r)
                     {
-                        deformable.got_black_holed = &black_hole;
+                        deformable.got_black_holed = black_holes.handle_at(j);
                     }
                 }
             }
         }
     }
+
+    profiler.add_count(counter_bbox_tests, bbox_tests);
+    profiler.add_count(counter_vertex_pair_tests, vertex_pair_tests);
+}
+
+// Compute the first time t in [0,1] at which the point p0 + t (p1 - p0) enters
+// the sphere (center, radius). Return false if the segment doesn't enter it
+// (including when p0 is already inside: discrete collisions handle it).
+static bool swept_sphere_time_of_impact(vec3 const &p0, vec3 const &p1,
+                                        vec3 const &center, float radius,
+                                        float &t)
+{
+    const vec3 d = p1 - p0;
+    const vec3 f = p0 - center;
+    const float c = dot(f, f) - radius * radius;
+    const float b = dot(f, d);
+    // Already inside, or moving away from the sphere
+    if (c < 0 || b >= 0)
+        return false;
+
+    const float a = dot(d, d);
+    const float discriminant = b * b - a * c;
+    if (discriminant < 0)
+        return false;
+
+    t = (-b - std::sqrt(discriminant)) / a;
+    return t <= 1.0f;
+}
+
+void continuous_collision(deformable_store &deformables,
+                          const std::vector<Planet> &planets,
+                          const SlotMap<BlackHole> &black_holes,
+                          simulation_parameter const &param)
+{
+    scoped_timer timer(phase_continuous_collision);
+
+    const float r = param.collision_radius; // radius of colliding sphere
+
+    long long bbox_tests = 0;
+    long long vertex_pair_tests = 0;
+    long long contacts_resolved = 0;
+    for (shape_deformable_structure &deformable : deformables)
+    {
+        if (deformable.step_dt == 0)
+        {
+            continue;
+        }
+
+        // Bounding box of the volume swept by the shape during the step
+        bounding_box swept_bbox;
+        swept_bbox.initialize(deformable.position_predict);
+        for (const vec3 &p : deformable.position)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                swept_bbox.p_min[c] = std::min(swept_bbox.p_min[c], p[c]);
+                swept_bbox.p_max[c] = std::max(swept_bbox.p_max[c], p[c]);
+            }
+        }
+        swept_bbox.extends(r);
+
+        for (const Planet &planet : planets)
+        {
+            ++bbox_tests;
+            if (!bounding_box::collide(swept_bbox, planet.get_bounding_box()))
+            {
+                continue;
+            }
+
+            vertex_pair_tests += deformable.size();
+            const float radius = planet.get_radius() + r;
+            for (int k = 0; k < deformable.size(); ++k)
+            {
+                const vec3 &p = deformable.position[k];
+                vec3 &p_predict = deformable.position_predict[k];
+                float t;
+                if (swept_sphere_time_of_impact(p, p_predict,
+                                                planet.get_center(), radius,
+                                                t))
+                {
+                    // Stop the particle where it touches the planet
+                    p_predict = p + t * (p_predict - p);
+                    ++contacts_resolved;
+                }
+            }
+        }
+
+        for (int j = 0; j < black_holes.size(); ++j)
+        {
+            const BlackHole &black_hole = black_holes[j];
+            ++bbox_tests;
+            if (!bounding_box::collide(swept_bbox,
+                                       black_hole.get_bounding_box()))
+            {
+                continue;
+            }
+
+            vertex_pair_tests += deformable.size();
+            const float radius = black_hole.get_radius() + r;
+            for (int k = 0; k < deformable.size(); ++k)
+            {
+                float t;
+                if (swept_sphere_time_of_impact(deformable.position[k],
+                                                deformable.position_predict[k],
+                                                black_hole.get_center(),
+                                                radius, t))
+                {
+                    // Crossing the black hole is enough to be captured
+                    deformable.got_black_holed = black_holes.handle_at(j);
+                    break;
+                }
+            }
+        }
+    }
+
+    profiler.add_count(counter_bbox_tests, bbox_tests);
+    profiler.add_count(counter_vertex_pair_tests, vertex_pair_tests);
+    profiler.add_count(counter_contacts_resolved, contacts_resolved);
 }
 
 // Compute the collision between the particles and the walls
 // Note: This function is already pre-coded
-void collision_with_walls(std::vector<shape_deformable_structure> &deformables)
+void collision_with_walls(deformable_store &deformables)
 {
     int N_deformable = deformables.size();
     for (int kd = 0; kd < N_deformable; ++kd)
@@ -466,58 +1153,93 @@ void collision_with_walls(std::vector<shape_deformable_structure> &deformables)
 }
 
 // Compute the attraction of the planet
-void planetary_attraction(std::vector<shape_deformable_structure> &deformables,
+void planetary_attraction(deformable_store &deformables,
                           const std::vector<Planet> &planets,
-                          const std::vector<BlackHole> &black_holes,
+                          const SlotMap<BlackHole> &black_holes,
                           simulation_parameter const &param)
 {
-    constexpr float G = 6.67 * 1e-11;
-    // const vec3 gravity = vec3(0.0f, 0.0f, -9.81f);
+    scoped_timer timer(phase_planetary_attraction);
+    planetary_attraction_range<generic_step_policy>(
+        deformables, 0, deformables.size(), planets, black_holes, param);
+}
 
-    const int N_deformable = deformables.size();
-    const float dt = param.time_step;
+// Attraction of the planet at the given position, if within its radius of
+// attraction
+static bool planet_gravity(const Planet &planet, vec3 const &position,
+                           vec3 &gravity)
+{
+    const vec3 planet_vector = planet.get_center() - position;
+    const float n = norm(planet_vector);
+    if (n > planet.get_attraction_radius())
+    {
+        return false;
+    }
+    constexpr float random_mass_factor = 25;
+    // In reality, it's : G * m1 * m2 / (n * n)
+    gravity = random_mass_factor * normalize(planet_vector) / (n * n);
+    return true;
+}
 
-    for (int kd = 0; kd < N_deformable; ++kd)
+static bool black_hole_gravity(const BlackHole &black_hole,
+                               vec3 const &position, vec3 &gravity)
+{
+    const vec3 black_hole_vector = black_hole.get_center() - position;
+    if (norm(black_hole_vector) > black_hole.get_attraction_radius())
     {
-        if (deformables[kd].got_black_holed != nullptr)
-        {
-            continue;
-        }
+        return false;
+    }
+    constexpr float random_mass_factor = 40;
+    gravity = random_mass_factor * normalize(black_hole_vector);
+    return true;
+}
 
+template <typename Policy>
+void planetary_attraction_range(deformable_store &deformables, int begin,
+                                int end, const std::vector<Planet> &planets,
+                                const SlotMap<BlackHole> &black_holes,
+                                simulation_parameter const &param)
+{
+    constexpr float G = 6.67 * 1e-11;
+    // const vec3 gravity = vec3(0.0f, 0.0f, -9.81f);
+
+    for (int kd = begin; kd < end; ++kd)
+    {
         // For all the deformable shapes
         shape_deformable_structure &deformable = deformables[kd];
         const int N_vertex = deformable.position.size();
+        // Time step of the shape (0 when its level of detail skips the step)
+        const float dt = deformable.step_dt;
+        if (dt == 0)
+        {
+            continue;
+        }
+        // The drag can't reverse the velocity, even for the larger time steps
+        // of the far shapes
+        const float drag = std::max(0.0f, 1 - dt * param.friction);
 
+        // The first planet in range attracts the shape, unless a black hole
+        // is in range
         auto combined_gravity = vec3(0.0, 0.0, 0.0);
-        for (const auto &planet : planets)
+        if constexpr (Policy::single_planet)
         {
-            vec3 planet_vector = planet.get_center() - deformable.com;
-            const float n = norm(planet_vector);
-            const auto attraction_radius = planet.get_attraction_radius();
-
-            if (n <= attraction_radius)
+            planet_gravity(planets[0], deformable.com, combined_gravity);
+        }
+        else
+        {
+            for (const auto &planet : planets)
             {
-                constexpr float random_mass_factor = 25;
-                // In reality, it's : G * m1 * m2 / (n * n)
-                combined_gravity =
-                    random_mass_factor * normalize(planet_vector) / (n * n);
-                break;
+                if (planet_gravity(planet, deformable.com, combined_gravity))
+                    break;
             }
         }
 
-        for (const auto &black_hole : black_holes)
+        if constexpr (Policy::black_holes)
         {
-            vec3 black_hole_vector = black_hole.get_center() - deformable.com;
-            const float n = norm(black_hole_vector);
-            const auto attraction_radius = black_hole.get_attraction_radius();
-
-            if (n <= attraction_radius)
+            for (const auto &black_hole : black_holes)
             {
-                constexpr float random_mass_factor = 40;
-                // In reality, it's : G * m1 * m2 / (n * n)
-                combined_gravity =
-                    random_mass_factor * normalize(black_hole_vector);
-                break;
+                if (black_hole_gravity(black_hole, deformable.com,
+                                       combined_gravity))
+                    break;
             }
         }
 
@@ -527,9 +1249,8 @@ void planetary_attraction(std::vector<shape_deformable_structure> &deformables,
 
             // Standard integration of external forces
             //   drag + gravity
-            deformable.velocity[k] =
-                deformable.velocity[k] * (1 - dt * param.friction)
-                + dt * combined_gravity;
+            deformable.velocity[k] = deformable.velocity[k] * drag
+                + dt * (combined_gravity + deformable.mutual_gravity);
             //   predicted position
             deformable.position_predict[k] =
                 deformable.position[k] + dt * deformable.velocity[k];
@@ -537,6 +1258,82 @@ void planetary_attraction(std::vector<shape_deformable_structure> &deformables,
     }
 }
 
+// Passes of each step configuration, instantiated for the solver backends
+#define INSTANTIATE_STEP_PASSES(BLACK_HOLES, SINGLE_PLANET, RIGID)           \
+    template void planetary_attraction_range<                               \
+        step_policy<BLACK_HOLES, SINGLE_PLANET, RIGID>>(                    \
+        deformable_store &, int, int, const std::vector<Planet> &,          \
+        const SlotMap<BlackHole> &, simulation_parameter const &);          \
+    template float shape_matching_range<                                    \
+        step_policy<BLACK_HOLES, SINGLE_PLANET, RIGID>>(                    \
+        deformable_store &, int, int, simulation_parameter const &);
+
+INSTANTIATE_STEP_PASSES(false, false, false)
+INSTANTIATE_STEP_PASSES(false, false, true)
+INSTANTIATE_STEP_PASSES(false, true, false)
+INSTANTIATE_STEP_PASSES(false, true, true)
+INSTANTIATE_STEP_PASSES(true, false, false)
+INSTANTIATE_STEP_PASSES(true, false, true)
+INSTANTIATE_STEP_PASSES(true, true, false)
+INSTANTIATE_STEP_PASSES(true, true, true)
+#undef INSTANTIATE_STEP_PASSES
+
+void mutual_gravity(deformable_store &deformables,
+                    simulation_parameter const &param, StepArena &arena)
+{
+    const mutual_gravity_parameter &gravity = param.mutual_gravity;
+    const int N_deformable = deformables.size();
+    if (!gravity.enabled)
+    {
+        for (shape_deformable_structure &deformable : deformables)
+        {
+            deformable.mutual_gravity = { 0, 0, 0 };
+        }
+        return;
+    }
+
+    scoped_timer timer(phase_mutual_gravity);
+    BarnesHutTree tree;
+    build_mutual_gravity_tree(deformables, arena, tree);
+    mutual_gravity_range(deformables, 0, N_deformable, tree, param);
+}
+
+void build_mutual_gravity_tree(const deformable_store &deformables,
+                               StepArena &arena, BarnesHutTree &tree)
+{
+    // Point masses at the centers of mass
+    const int N_deformable = deformables.size();
+    vec3 *positions = arena.allocate<vec3>(N_deformable);
+    float *masses = arena.allocate<float>(N_deformable);
+    for (int kd = 0; kd < N_deformable; ++kd)
+    {
+        positions[kd] = deformables[kd].com;
+        masses[kd] = float(deformables[kd].size());
+    }
+    tree.build(positions, masses, N_deformable, arena);
+}
+
+void mutual_gravity_range(deformable_store &deformables, int begin, int end,
+                          const BarnesHutTree &tree,
+                          simulation_parameter const &param)
+{
+    const mutual_gravity_parameter &gravity = param.mutual_gravity;
+    for (int kd = begin; kd < end; ++kd)
+    {
+        deformables[kd].mutual_gravity = tree.acceleration(
+            kd, gravity.theta, gravity.softening, gravity.strength);
+    }
+}
+
+vec3 center_of_mass(numarray<vec3> const &positions)
+{
+    const int N = positions.size();
+    vec3 sum = { 0, 0, 0 };
+    for (int k = 0; k < N; ++k)
+        sum += positions[k];
+    return N > 0 ? sum / float(N) : sum;
+}
+
 // Compute the polar decomposition of the matrix M and return the rotation such
 // that
 //   M = R * S, where R is a rotation matrix and S is a positive semi-definite
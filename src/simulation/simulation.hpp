@@ -1,5 +1,86 @@
+#pragma once
+
 #include "../deformable/deformable.hpp"
 #include "../objects/planet.hpp"
+#include "step_arena.hpp"
+
+// Solver used to project the constraints of a simulation step
+enum solver_type_enum
+{
+    // Hard projections, shape matching blended by the elasticity
+    solver_ppd,
+    // Compliant constraints with Lagrange multipliers (stiffness independent
+    // of the time step and of the number of iterations)
+    solver_xpbd
+};
+
+// Implementation of the passes of the simulation steps (see SolverBackend),
+// switched at runtime to compare them on the same scene
+enum solver_backend_enum
+{
+    // Plain scalar loops
+    backend_reference,
+    // Contacts with the planets by blocks of particles (vector instructions)
+    backend_simd,
+    // SIMD passes split over the workers of the task pool
+    backend_threaded,
+    // SIMD passes compiled for the configuration of the scene (no black hole,
+    // single planet, rigid shapes), without the branches it doesn't need
+    backend_specialized,
+    solver_backend_count
+};
+
+// Distance class of a shape to the nearest of the player and the camera
+enum physics_lod_enum
+{
+    // Fully simulated
+    physics_lod_near,
+    // Fewer collision handling steps
+    physics_lod_mid,
+    // Fewer collision handling steps, and integrated only every
+    // far_tick_interval steps with a time step as much larger
+    physics_lod_far
+};
+
+// Distance based level of detail of the simulation, set per scene
+struct physics_lod_parameter
+{
+    bool enabled = false;
+    // Distances to the player or the camera delimiting the levels
+    float near_distance = 5.0f;
+    float far_distance = 15.0f;
+    // Maximum number of collision handling steps of the mid and far shapes
+    int mid_collision_steps = 2;
+    // Number of steps between two integrations of a far shape
+    int far_tick_interval = 4;
+};
+
+// Attraction of the shapes to each other (N-body), approximated with a
+// Barnes-Hut octree over their centers of mass rebuilt at each step
+struct mutual_gravity_parameter
+{
+    bool enabled = false;
+    // Gravitational constant times the mass of a particle (the mass of a
+    // shape is its number of particles)
+    float strength = 0.005f;
+    // Opening criterion: a group of shapes is replaced by its center of mass
+    // when its size is below theta times its distance (0: exact sum)
+    float theta = 0.7f;
+    // Softening length: the squared distances are increased by its square,
+    // which bounds the attraction of close shapes
+    float softening = 0.3f;
+};
+
+// Contacts kept across the collision iterations and the steps (see
+// particle_contact_cache), instead of searched again at each iteration
+struct contact_cache_parameter
+{
+    // Off until the golden states confirm that it leaves the results unchanged
+    bool enabled = false;
+    // Distance added to the contact distance by the searches: their contacts
+    // hold until the shapes have moved by this distance
+    float skin = 0.02f;
+};
 
 struct simulation_parameter
 {
@@ -13,16 +94,62 @@ struct simulation_parameter
     // Velocity reduction at each time step (* dt);
     float friction = 1.0f;
     // Numer of collision handling step for each numerical integration
+    // (maximum number when the iterations are adaptive)
     int collision_steps = 5;
+    // Stop the collision handling steps once the largest correction of an
+    // iteration is below residual_tolerance, after min_collision_steps
+    bool adaptive_iterations = true;
+    int min_collision_steps = 1;
+    float residual_tolerance = 1e-4f;
+    // Sweep the particles along their motion to catch the collisions with the
+    // planets and black holes happening within a time step (no tunneling)
+    bool continuous_collision = true;
 
     // Time step of the numerical time integration
     float time_step = 0.005f;
 
+    solver_type_enum solver = solver_ppd;
+    solver_backend_enum backend = backend_simd;
+    // Compliance (inverse of the stiffness) of the XPBD constraints, 0 for
+    // infinitely stiff constraints
+    float contact_compliance = 0.0f;
+    float shape_compliance = 1e-7f;
+
     float black_hole_timer = 1.0f;
+
+    physics_lod_parameter physics_lod;
+    mutual_gravity_parameter mutual_gravity;
+    contact_cache_parameter contact_cache;
 };
 
-void simulation_step(std::vector<shape_deformable_structure> &deformables,
-                     const std::vector<Planet> &planets,
-                     const std::vector<BlackHole> &black_holes,
-                     simulation_parameter const &param,
-                     const cgp::camera_orbit_euler &camera);
\ No newline at end of file
+// Convergence of the constraint projections of a simulation step
+struct simulation_report
+{
+    // Number of collision handling steps performed
+    int iterations = 0;
+    // Largest correction (penetration or shape matching displacement) of the
+    // last iteration
+    float residual = 0.0f;
+};
+
+class SolverBackend;
+
+// Perform one simulation step. The level of detail of each shape depends on
+// its distance to the player and to the camera position. The passes are run
+// by the given backend (the one of param.backend in the scene).
+simulation_report simulation_step(deformable_store &deformables,
+                                  slot_handle player,
+                                  cgp::vec3 const &camera_position,
+                                  const std::vector<Planet> &planets,
+                                  const SlotMap<BlackHole> &black_holes,
+                                  simulation_parameter const &param,
+                                  SolverBackend &backend, StepArena &arena);
+
+// Compute the polar decomposition of the matrix M and return the rotation such
+// that
+//   M = R * S, where R is a rotation matrix and S is a positive semi-definite
+//   matrix
+cgp::mat3 polar_decomposition(cgp::mat3 const &M);
+
+// Average of the positions, computed without any temporary array
+cgp::vec3 center_of_mass(cgp::numarray<cgp::vec3> const &positions);
\ No newline at end of file
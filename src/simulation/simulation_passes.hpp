@@ -0,0 +1,119 @@
+#pragma once
+
+#include "simulation/barnes_hut.hpp"
+#include "simulation/simulation.hpp"
+#include "simulation/sphere_contacts.hpp"
+#include "simulation/step_arena.hpp"
+
+// Passes of a simulation step (see simulation_step), exposed to run them
+// separately in the kernel benchmarks.
+// The *_range variants only process the shapes of dense indices in
+// [begin, end), without measuring their time: the solver backends split the
+// passes with them.
+
+// Step configuration known at compile time, the *_range passes templated on
+// it skipping the absent features (see SpecializedSolverBackend)
+template <bool BlackHoles, bool SinglePlanet, bool Rigid>
+struct step_policy
+{
+    static constexpr bool black_holes = BlackHoles;
+    static constexpr bool single_planet = SinglePlanet;
+    static constexpr bool rigid = Rigid;
+};
+// Policy of any scene: black holes, planets and elasticity are all tested
+using generic_step_policy = step_policy<true, false, false>;
+
+// Apply the attraction of the planets and black holes to the velocities, and
+// compute the predicted positions
+void planetary_attraction(deformable_store &deformables,
+                          const std::vector<Planet> &planets,
+                          const SlotMap<BlackHole> &black_holes,
+                          simulation_parameter const &param);
+template <typename Policy>
+void planetary_attraction_range(deformable_store &deformables, int begin,
+                                int end, const std::vector<Planet> &planets,
+                                const SlotMap<BlackHole> &black_holes,
+                                simulation_parameter const &param);
+
+// Attraction of each shape by all the others (Barnes-Hut approximation), set
+// in their mutual_gravity acceleration (reset to zero when disabled)
+void mutual_gravity(deformable_store &deformables,
+                    simulation_parameter const &param, StepArena &arena);
+// Tree of the centers of mass of the shapes (computed at the start of the
+// step), weighted by their number of particles
+void build_mutual_gravity_tree(const deformable_store &deformables,
+                               StepArena &arena, BarnesHutTree &tree);
+// tree: built by build_mutual_gravity_tree (only read)
+void mutual_gravity_range(deformable_store &deformables, int begin, int end,
+                          const BarnesHutTree &tree,
+                          simulation_parameter const &param);
+
+// Compute the bounding box of the predicted positions of each deformable
+// shape, extended by the collision radius. The boxes are shared by the three
+// collision passes of an iteration.
+// The boxes are the ones of the placed sphere trees: the trees not placed by
+// the shape matching of the last iteration are placed on the predicted
+// positions first.
+void compute_bounding_boxes(deformable_store &deformables,
+                            simulation_parameter const &param,
+                            cgp::bounding_box *bbox);
+
+// Compute the collision between the particles and the walls
+void collision_with_walls(deformable_store &deformables);
+
+// Sweep each particle from its position to its predicted position, and clamp
+// the predicted position at the time of impact with the planets (or capture
+// the shape by the black holes), so that fast shapes can't tunnel through
+void continuous_collision(deformable_store &deformables,
+                          const std::vector<Planet> &planets,
+                          const SlotMap<BlackHole> &black_holes,
+                          simulation_parameter const &param);
+
+// Compute the collision between the particles and the planets, return the
+// largest correction applied to a particle
+float collision_with_planets(
+    deformable_store &deformables,
+    const cgp::bounding_box *bbox, const std::vector<Planet> &planets,
+    simulation_parameter const &param, StepArena &arena);
+// touching: room for one collider per planet, resolve_contacts: kernel
+// pushing the particles out of the planets touching the shape
+float collision_with_planets_range(
+    deformable_store &deformables, int begin, int end,
+    const cgp::bounding_box *bbox, const std::vector<Planet> &planets,
+    simulation_parameter const &param, sphere_collider *touching,
+    sphere_contact_function resolve_contacts);
+
+// Compute the collision between the particles and the black_holes
+void collision_with_black_holes(
+    deformable_store &deformables,
+    const cgp::bounding_box *bbox, const SlotMap<BlackHole> &black_holes,
+    simulation_parameter const &param);
+
+// Compute the collision between the particles to each other, return the
+// largest correction applied to a particle (the sphere trees must have been
+// placed by compute_bounding_boxes)
+float collision_between_particles(
+    deformable_store &deformables,
+    const cgp::bounding_box *bbox, simulation_parameter const &param);
+
+// Compute the shape matching on all the deformable shapes, return the largest
+// displacement of a particle
+float shape_matching(deformable_store &deformables,
+                     simulation_parameter const &param);
+template <typename Policy>
+float shape_matching_range(deformable_store &deformables, int begin, int end,
+                           simulation_parameter const &param);
+// Place the sphere tree of the shape on its predicted positions after its
+// shape matching, from the rotation R of its positions and the largest
+// distance left between a particle and its goal
+void place_sphere_tree(shape_deformable_structure &deformable,
+                       cgp::mat3 const &R, float goal_distance);
+
+// Update the velocity and the position from the predicted position
+void update_velocity(deformable_store &deformables,
+                     simulation_parameter const &param);
+void update_velocity_range(deformable_store &deformables, int begin, int end);
+
+// Move the player along the surface of the planet attracting it
+void move_player(deformable_store &deformables, slot_handle player,
+                 const std::vector<Planet> &planets);
@@ -0,0 +1,348 @@
+#include "simulation/solver_backend.hpp"
+
+#include <algorithm>
+#include <mutex>
+
+#include "objects/black_hole.hpp"
+#include "objects/planet.hpp"
+#include "profiling/profiler.hpp"
+#include "simulation/simulation_passes.hpp"
+
+using namespace cgp;
+
+const char *SolverBackend::name() const
+{
+    return "Reference";
+}
+
+void SolverBackend::prepare(const std::vector<Planet> &,
+                            const SlotMap<BlackHole> &,
+                            simulation_parameter const &)
+{}
+
+void SolverBackend::mutual_gravity(deformable_store &deformables,
+                                   simulation_parameter const &param,
+                                   StepArena &arena)
+{
+    ::mutual_gravity(deformables, param, arena);
+}
+
+void SolverBackend::planetary_attraction(deformable_store &deformables,
+                                         const std::vector<Planet> &planets,
+                                         const SlotMap<BlackHole> &black_holes,
+                                         simulation_parameter const &param)
+{
+    ::planetary_attraction(deformables, planets, black_holes, param);
+}
+
+float SolverBackend::collision_between_particles(
+    deformable_store &deformables, const bounding_box *bbox,
+    simulation_parameter const &param)
+{
+    return ::collision_between_particles(deformables, bbox, param);
+}
+
+float SolverBackend::collision_with_planets(deformable_store &deformables,
+                                            const bounding_box *bbox,
+                                            const std::vector<Planet> &planets,
+                                            simulation_parameter const &param,
+                                            StepArena &arena)
+{
+    scoped_timer timer(phase_collision_planets);
+    sphere_collider *touching =
+        arena.allocate<sphere_collider>(planets.size());
+    return collision_with_planets_range(deformables, 0, deformables.size(),
+                                        bbox, planets, param, touching,
+                                        resolve_sphere_contacts_scalar);
+}
+
+void SolverBackend::collision_with_black_holes(
+    deformable_store &deformables, const bounding_box *bbox,
+    const SlotMap<BlackHole> &black_holes, simulation_parameter const &param)
+{
+    ::collision_with_black_holes(deformables, bbox, black_holes, param);
+}
+
+float SolverBackend::shape_matching(deformable_store &deformables,
+                                    simulation_parameter const &param)
+{
+    return ::shape_matching(deformables, param);
+}
+
+void SolverBackend::update_velocity(deformable_store &deformables,
+                                    simulation_parameter const &param)
+{
+    ::update_velocity(deformables, param);
+}
+
+const char *SimdSolverBackend::name() const
+{
+    return "SIMD";
+}
+
+float SimdSolverBackend::collision_with_planets(
+    deformable_store &deformables, const bounding_box *bbox,
+    const std::vector<Planet> &planets, simulation_parameter const &param,
+    StepArena &arena)
+{
+    return ::collision_with_planets(deformables, bbox, planets, param, arena);
+}
+
+ThreadedSolverBackend::ThreadedSolverBackend(TaskPool &pool)
+    : _pool(pool)
+{}
+
+const char *ThreadedSolverBackend::name() const
+{
+    return "Multithreaded";
+}
+
+void ThreadedSolverBackend::mutual_gravity(deformable_store &deformables,
+                                           simulation_parameter const &param,
+                                           StepArena &arena)
+{
+    // Nothing to split when disabled (the accelerations are reset)
+    if (!param.mutual_gravity.enabled)
+    {
+        SolverBackend::mutual_gravity(deformables, param, arena);
+        return;
+    }
+
+    scoped_timer timer(phase_mutual_gravity);
+    BarnesHutTree tree;
+    build_mutual_gravity_tree(deformables, arena, tree);
+    // The tree is only read: the shapes are independent
+    _pool.parallel_for(deformables.size(), grain, [&](int begin, int end) {
+        mutual_gravity_range(deformables, begin, end, tree, param);
+    });
+}
+
+void ThreadedSolverBackend::planetary_attraction(
+    deformable_store &deformables, const std::vector<Planet> &planets,
+    const SlotMap<BlackHole> &black_holes, simulation_parameter const &param)
+{
+    scoped_timer timer(phase_planetary_attraction);
+    _pool.parallel_for(deformables.size(), grain, [&](int begin, int end) {
+        planetary_attraction_range<generic_step_policy>(
+            deformables, begin, end, planets, black_holes, param);
+    });
+}
+
+float ThreadedSolverBackend::collision_with_planets(
+    deformable_store &deformables, const bounding_box *bbox,
+    const std::vector<Planet> &planets, simulation_parameter const &param,
+    StepArena &arena)
+{
+    scoped_timer timer(phase_collision_planets);
+
+    // Colliders touching the current shape, one array per task
+    const int N_planet = planets.size();
+    const int N_task =
+        std::max(1, (int(deformables.size()) + grain - 1) / grain);
+    sphere_collider *touching =
+        arena.allocate<sphere_collider>(N_task * N_planet);
+    float *max_correction = arena.allocate<float>(N_task);
+    std::fill(max_correction, max_correction + N_task, 0.0f);
+
+    _pool.parallel_for(deformables.size(), grain, [&](int begin, int end) {
+        const int task = begin / grain;
+        max_correction[task] = collision_with_planets_range(
+            deformables, begin, end, bbox, planets, param,
+            touching + task * N_planet, resolve_sphere_contacts);
+    });
+    return *std::max_element(max_correction, max_correction + N_task);
+}
+
+float ThreadedSolverBackend::shape_matching(deformable_store &deformables,
+                                            simulation_parameter const &param)
+{
+    scoped_timer timer(phase_shape_matching);
+
+    std::mutex max_mutex;
+    float max_displacement = 0.0f;
+    _pool.parallel_for(deformables.size(), grain, [&](int begin, int end) {
+        const float displacement = shape_matching_range<generic_step_policy>(
+            deformables, begin, end, param);
+        std::lock_guard<std::mutex> lock(max_mutex);
+        max_displacement = std::max(max_displacement, displacement);
+    });
+    return max_displacement;
+}
+
+void ThreadedSolverBackend::update_velocity(deformable_store &deformables,
+                                            simulation_parameter const &)
+{
+    scoped_timer timer(phase_velocity_update);
+    _pool.parallel_for(deformables.size(), grain, [&](int begin, int end) {
+        update_velocity_range(deformables, begin, end);
+    });
+}
+
+namespace
+{
+    // Same passes as the SIMD backend, with the features absent from the
+    // policy removed at compile time
+    template <typename Policy>
+    class SpecializedPipeline : public SimdSolverBackend
+    {
+    public:
+        void planetary_attraction(deformable_store &deformables,
+                                  const std::vector<Planet> &planets,
+                                  const SlotMap<BlackHole> &black_holes,
+                                  simulation_parameter const &param) override
+        {
+            scoped_timer timer(phase_planetary_attraction);
+            planetary_attraction_range<Policy>(
+                deformables, 0, deformables.size(), planets, black_holes,
+                param);
+        }
+
+        void collision_with_black_holes(
+            deformable_store &deformables, const bounding_box *bbox,
+            const SlotMap<BlackHole> &black_holes,
+            simulation_parameter const &param) override
+        {
+            if constexpr (Policy::black_holes)
+            {
+                SimdSolverBackend::collision_with_black_holes(
+                    deformables, bbox, black_holes, param);
+            }
+        }
+
+        float shape_matching(deformable_store &deformables,
+                             simulation_parameter const &param) override
+        {
+            scoped_timer timer(phase_shape_matching);
+            return shape_matching_range<Policy>(
+                deformables, 0, deformables.size(), param);
+        }
+    };
+
+    template <bool BlackHoles, bool SinglePlanet, bool Rigid>
+    std::unique_ptr<SolverBackend> make_pipeline()
+    {
+        return std::make_unique<SpecializedPipeline<
+            step_policy<BlackHoles, SinglePlanet, Rigid>>>();
+    }
+
+    std::unique_ptr<SolverBackend> make_pipeline(
+        const step_configuration &configuration)
+    {
+        using pipeline_factory = std::unique_ptr<SolverBackend> (*)();
+        // Indexed by black_holes, single_planet, rigid (bits 2, 1, 0)
+        static const pipeline_factory factories[8] = {
+            make_pipeline<false, false, false>,
+            make_pipeline<false, false, true>,
+            make_pipeline<false, true, false>,
+            make_pipeline<false, true, true>,
+            make_pipeline<true, false, false>,
+            make_pipeline<true, false, true>,
+            make_pipeline<true, true, false>,
+            make_pipeline<true, true, true>
+        };
+        return factories[4 * configuration.black_holes
+                         + 2 * configuration.single_planet
+                         + configuration.rigid]();
+    }
+} // namespace
+
+step_configuration step_configuration::from_scene(
+    const std::vector<Planet> &planets, const SlotMap<BlackHole> &black_holes,
+    simulation_parameter const &param)
+{
+    step_configuration configuration;
+    configuration.black_holes = black_holes.size() > 0;
+    configuration.single_planet = planets.size() == 1;
+    configuration.rigid = param.elasticity == 0.0f;
+    return configuration;
+}
+
+bool step_configuration::operator==(const step_configuration &other) const
+{
+    return black_holes == other.black_holes
+        && single_planet == other.single_planet && rigid == other.rigid;
+}
+
+std::string step_configuration::description() const
+{
+    std::string text = black_holes ? "black holes" : "no black hole";
+    text += single_planet ? ", single planet" : ", planets";
+    text += rigid ? ", rigid" : ", elastic";
+    return text;
+}
+
+const char *SpecializedSolverBackend::name() const
+{
+    return "Specialized";
+}
+
+const step_configuration &SpecializedSolverBackend::configuration() const
+{
+    return _configuration;
+}
+
+void SpecializedSolverBackend::prepare(const std::vector<Planet> &planets,
+                                       const SlotMap<BlackHole> &black_holes,
+                                       simulation_parameter const &param)
+{
+    const step_configuration configuration =
+        step_configuration::from_scene(planets, black_holes, param);
+    if (_pipeline == nullptr || !(configuration == _configuration))
+    {
+        _configuration = configuration;
+        _pipeline = make_pipeline(configuration);
+    }
+}
+
+void SpecializedSolverBackend::planetary_attraction(
+    deformable_store &deformables, const std::vector<Planet> &planets,
+    const SlotMap<BlackHole> &black_holes, simulation_parameter const &param)
+{
+    _pipeline->planetary_attraction(deformables, planets, black_holes, param);
+}
+
+void SpecializedSolverBackend::collision_with_black_holes(
+    deformable_store &deformables, const bounding_box *bbox,
+    const SlotMap<BlackHole> &black_holes, simulation_parameter const &param)
+{
+    _pipeline->collision_with_black_holes(deformables, bbox, black_holes,
+                                          param);
+}
+
+float SpecializedSolverBackend::shape_matching(
+    deformable_store &deformables, simulation_parameter const &param)
+{
+    return _pipeline->shape_matching(deformables, param);
+}
+
+std::unique_ptr<SolverBackend> make_solver_backend(solver_backend_enum type,
+                                                   TaskPool &pool)
+{
+    switch (type)
+    {
+    case backend_simd:
+        return std::make_unique<SimdSolverBackend>();
+    case backend_threaded:
+        return std::make_unique<ThreadedSolverBackend>(pool);
+    case backend_specialized:
+        return std::make_unique<SpecializedSolverBackend>();
+    default:
+        return std::make_unique<SolverBackend>();
+    }
+}
+
+bool parse_solver_backend(const std::string &name, solver_backend_enum &type)
+{
+    static const char *names[solver_backend_count] = {
+        "reference", "simd", "threaded", "specialized"
+    };
+    for (int k = 0; k < solver_backend_count; ++k)
+    {
+        if (name == names[k])
+        {
+            type = solver_backend_enum(k);
+            return true;
+        }
+    }
+    return false;
+}
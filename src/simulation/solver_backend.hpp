@@ -0,0 +1,155 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "scheduling/task_pool.hpp"
+#include "simulation/simulation.hpp"
+#include "simulation/step_arena.hpp"
+
+// Implementation of the passes of a simulation step worth comparing on the
+// same scene (see simulation_step). The step itself (levels of detail,
+// iterations, XPBD multipliers) is shared by all of them.
+// The base class is the reference: plain scalar loops over the shapes and
+// their particles.
+class SolverBackend
+{
+public:
+    virtual ~SolverBackend() = default;
+
+    virtual const char *name() const;
+
+    // Called at the start of each step, before the passes
+    virtual void prepare(const std::vector<Planet> &planets,
+                         const SlotMap<BlackHole> &black_holes,
+                         simulation_parameter const &param);
+
+    virtual void mutual_gravity(deformable_store &deformables,
+                                simulation_parameter const &param,
+                                StepArena &arena);
+    virtual void planetary_attraction(deformable_store &deformables,
+                                      const std::vector<Planet> &planets,
+                                      const SlotMap<BlackHole> &black_holes,
+                                      simulation_parameter const &param);
+    virtual float collision_between_particles(
+        deformable_store &deformables, const cgp::bounding_box *bbox,
+        simulation_parameter const &param);
+    virtual float collision_with_planets(deformable_store &deformables,
+                                         const cgp::bounding_box *bbox,
+                                         const std::vector<Planet> &planets,
+                                         simulation_parameter const &param,
+                                         StepArena &arena);
+    virtual void collision_with_black_holes(
+        deformable_store &deformables, const cgp::bounding_box *bbox,
+        const SlotMap<BlackHole> &black_holes,
+        simulation_parameter const &param);
+    virtual float shape_matching(deformable_store &deformables,
+                                 simulation_parameter const &param);
+    virtual void update_velocity(deformable_store &deformables,
+                                 simulation_parameter const &param);
+};
+
+// Contacts with the planets resolved by blocks of particles with vector
+// instructions
+class SimdSolverBackend : public SolverBackend
+{
+public:
+    const char *name() const override;
+
+    float collision_with_planets(deformable_store &deformables,
+                                 const cgp::bounding_box *bbox,
+                                 const std::vector<Planet> &planets,
+                                 simulation_parameter const &param,
+                                 StepArena &arena) override;
+};
+
+// SIMD passes, the ones independent between the shapes being split over the
+// workers of a task pool. The contacts between the shapes stay on the calling
+// thread (each contact moves two shapes).
+class ThreadedSolverBackend : public SimdSolverBackend
+{
+public:
+    // Shapes processed by a task
+    static constexpr int grain = 4;
+
+    explicit ThreadedSolverBackend(TaskPool &pool);
+
+    const char *name() const override;
+
+    void mutual_gravity(deformable_store &deformables,
+                        simulation_parameter const &param,
+                        StepArena &arena) override;
+    void planetary_attraction(deformable_store &deformables,
+                              const std::vector<Planet> &planets,
+                              const SlotMap<BlackHole> &black_holes,
+                              simulation_parameter const &param) override;
+    float collision_with_planets(deformable_store &deformables,
+                                 const cgp::bounding_box *bbox,
+                                 const std::vector<Planet> &planets,
+                                 simulation_parameter const &param,
+                                 StepArena &arena) override;
+    float shape_matching(deformable_store &deformables,
+                         simulation_parameter const &param) override;
+    void update_velocity(deformable_store &deformables,
+                         simulation_parameter const &param) override;
+
+private:
+    TaskPool &_pool;
+};
+
+// Features of a scene the specialized pipelines are compiled for
+struct step_configuration
+{
+    bool black_holes = true;
+    // A single planet attracts the shapes
+    bool single_planet = false;
+    // No elasticity: the shape matching fully restores the shapes
+    bool rigid = false;
+
+    static step_configuration from_scene(const std::vector<Planet> &planets,
+                                         const SlotMap<BlackHole> &black_holes,
+                                         simulation_parameter const &param);
+    bool operator==(const step_configuration &other) const;
+    std::string description() const;
+};
+
+// SIMD passes, instantiated from templates for each step configuration: the
+// scenes without black holes skip their tests, a single planet needs no loop
+// over the planets, and the rigid shapes don't blend the shape matching.
+// The pipeline is chosen again only when the configuration of the scene
+// changes (new black hole, elasticity set in the GUI...).
+class SpecializedSolverBackend : public SimdSolverBackend
+{
+public:
+    const char *name() const override;
+    const step_configuration &configuration() const;
+
+    void prepare(const std::vector<Planet> &planets,
+                 const SlotMap<BlackHole> &black_holes,
+                 simulation_parameter const &param) override;
+
+    void planetary_attraction(deformable_store &deformables,
+                              const std::vector<Planet> &planets,
+                              const SlotMap<BlackHole> &black_holes,
+                              simulation_parameter const &param) override;
+    void collision_with_black_holes(
+        deformable_store &deformables, const cgp::bounding_box *bbox,
+        const SlotMap<BlackHole> &black_holes,
+        simulation_parameter const &param) override;
+    float shape_matching(deformable_store &deformables,
+                         simulation_parameter const &param) override;
+
+private:
+    step_configuration _configuration;
+    // Instantiation of the passes for the configuration
+    std::unique_ptr<SolverBackend> _pipeline;
+};
+
+// Backend of the given type (the threaded one runs its tasks on the pool)
+std::unique_ptr<SolverBackend> make_solver_backend(solver_backend_enum type,
+                                                   TaskPool &pool);
+
+// Backend of the given name (reference, simd, threaded or specialized), return
+// false if the name is unknown
+bool parse_solver_backend(const std::string &name, solver_backend_enum &type);
@@ -0,0 +1,158 @@
+#include "simulation/sphere_contacts.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+using namespace cgp;
+
+namespace
+{
+    // Bit mask of the lanes whose particle is strictly inside the sphere
+    int contact_mask(const float *x, const float *y, const float *z,
+                     sphere_collider const &sphere)
+    {
+        const float radius2 = sphere.radius * sphere.radius;
+#if defined(__AVX__)
+        const __m256 dx = _mm256_sub_ps(_mm256_load_ps(x),
+                                        _mm256_set1_ps(sphere.center.x));
+        const __m256 dy = _mm256_sub_ps(_mm256_load_ps(y),
+                                        _mm256_set1_ps(sphere.center.y));
+        const __m256 dz = _mm256_sub_ps(_mm256_load_ps(z),
+                                        _mm256_set1_ps(sphere.center.z));
+        const __m256 d2 =
+            _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx),
+                                        _mm256_mul_ps(dy, dy)),
+                          _mm256_mul_ps(dz, dz));
+        return _mm256_movemask_ps(
+            _mm256_cmp_ps(d2, _mm256_set1_ps(radius2), _CMP_LT_OQ));
+#else
+        // Branchless fixed width loop, vectorized by the compiler
+        int mask = 0;
+        for (int lane = 0; lane < sphere_contact_lanes; ++lane)
+        {
+            const float dx = x[lane] - sphere.center.x;
+            const float dy = y[lane] - sphere.center.y;
+            const float dz = z[lane] - sphere.center.z;
+            mask |= int(dx * dx + dy * dy + dz * dz < radius2) << lane;
+        }
+        return mask;
+#endif
+    }
+} // namespace
+
+float resolve_sphere_contacts(numarray<vec3> &positions,
+                              const sphere_collider *spheres, int N_sphere,
+                              long long &contacts_resolved)
+{
+    constexpr int lanes = sphere_contact_lanes;
+    // Unused lanes of the last block are sent to infinity: never in contact
+    constexpr float far_away = std::numeric_limits<float>::infinity();
+
+    float max_correction = 0.0f;
+    const int N = positions.size();
+    for (int start = 0; start < N; start += lanes)
+    {
+        const int count = std::min(lanes, N - start);
+
+        // Structure of arrays copy of the block
+        alignas(32) float x[lanes];
+        alignas(32) float y[lanes];
+        alignas(32) float z[lanes];
+        for (int lane = 0; lane < lanes; ++lane)
+        {
+            if (lane < count)
+            {
+                const vec3 &p = positions[start + lane];
+                x[lane] = p.x;
+                y[lane] = p.y;
+                z[lane] = p.z;
+            }
+            else
+            {
+                x[lane] = y[lane] = z[lane] = far_away;
+            }
+        }
+
+        bool moved = false;
+        for (int s = 0; s < N_sphere; ++s)
+        {
+            const sphere_collider &sphere = spheres[s];
+            const int mask = contact_mask(x, y, z, sphere);
+            if (mask == 0)
+            {
+                continue;
+            }
+
+            // Only the particles in contact need the distance
+            for (int lane = 0; lane < lanes; ++lane)
+            {
+                if (!(mask & (1 << lane)))
+                {
+                    continue;
+                }
+
+                const float dx = x[lane] - sphere.center.x;
+                const float dy = y[lane] - sphere.center.y;
+                const float dz = z[lane] - sphere.center.z;
+                const float n = std::sqrt(dx * dx + dy * dy + dz * dz);
+                // No direction to push a particle at the center
+                if (n < 1e-6f)
+                {
+                    continue;
+                }
+
+                const float penetration = sphere.radius - n;
+                const float scale = penetration / n;
+                x[lane] += scale * dx;
+                y[lane] += scale * dy;
+                z[lane] += scale * dz;
+                max_correction = std::max(max_correction, penetration);
+                ++contacts_resolved;
+                moved = true;
+            }
+        }
+
+        if (moved)
+        {
+            for (int lane = 0; lane < count; ++lane)
+            {
+                positions[start + lane] = vec3(x[lane], y[lane], z[lane]);
+            }
+        }
+    }
+
+    return max_correction;
+}
+
+float resolve_sphere_contacts_scalar(numarray<vec3> &positions,
+                                     const sphere_collider *spheres,
+                                     int N_sphere,
+                                     long long &contacts_resolved)
+{
+    float max_correction = 0.0f;
+    for (vec3 &p : positions)
+    {
+        for (int s = 0; s < N_sphere; ++s)
+        {
+            const sphere_collider &sphere = spheres[s];
+            const vec3 d = p - sphere.center;
+            const float n = norm(d);
+            // No direction to push a particle at the center
+            if (n >= sphere.radius || n < 1e-6f)
+            {
+                continue;
+            }
+
+            const float penetration = sphere.radius - n;
+            p += (penetration / n) * d;
+            max_correction = std::max(max_correction, penetration);
+            ++contacts_resolved;
+        }
+    }
+    return max_correction;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "cgp/cgp.hpp"
+
+// Static sphere the particles can't enter (a planet), with the collision
+// radius of the particles already added to its radius
+struct sphere_collider
+{
+    cgp::vec3 center;
+    float radius = 0.0f;
+};
+
+// Number of particles tested together by the contact kernel
+constexpr int sphere_contact_lanes = 8;
+
+// Push the particles out of all the given spheres in a single pass over the
+// particles, and return the largest correction applied.
+// The particles are processed by blocks of sphere_contact_lanes: the squared
+// distances to a sphere are compared for the whole block at once, and the
+// square roots are only computed for the particles in contact. The spheres are
+// handled in order for each particle, as separate passes over the spheres
+// would do.
+float resolve_sphere_contacts(cgp::numarray<cgp::vec3> &positions,
+                              const sphere_collider *spheres, int N_sphere,
+                              long long &contacts_resolved);
+
+// Same contacts, one particle and one sphere at a time (reference of the
+// vectorized kernel)
+float resolve_sphere_contacts_scalar(cgp::numarray<cgp::vec3> &positions,
+                                     const sphere_collider *spheres,
+                                     int N_sphere,
+                                     long long &contacts_resolved);
+
+// Signature of the two kernels above
+using sphere_contact_function = float (*)(cgp::numarray<cgp::vec3> &,
+                                          const sphere_collider *, int,
+                                          long long &);
@@ -0,0 +1,53 @@
+#include "simulation/step_arena.hpp"
+
+#include <cstdint>
+
+StepArena::StepArena(std::size_t capacity)
+    : _buffer(capacity)
+{}
+
+void StepArena::reset()
+{
+    // Grow the buffer to hold everything the last step asked for
+    if (_requested > _buffer.size())
+        _buffer.resize(2 * _requested);
+
+    _overflow.clear();
+    _offset = 0;
+    _requested = 0;
+}
+
+std::size_t StepArena::used() const
+{
+    return _requested;
+}
+
+std::size_t StepArena::capacity() const
+{
+    return _buffer.size();
+}
+
+void *StepArena::allocate_bytes(std::size_t size, std::size_t alignment)
+{
+    // Worst case padding is counted so that the next reset always makes
+    // enough room
+    _requested += size + alignment;
+
+    const std::uintptr_t base =
+        reinterpret_cast<std::uintptr_t>(_buffer.data());
+    const std::uintptr_t aligned =
+        (base + _offset + alignment - 1) & ~std::uintptr_t(alignment - 1);
+    const std::size_t end = aligned - base + size;
+    if (end <= _buffer.size())
+    {
+        _offset = end;
+        return reinterpret_cast<void *>(aligned);
+    }
+
+    // Doesn't fit: fall back to the heap until the next reset
+    _overflow.emplace_back(new std::byte[size + alignment]);
+    const std::uintptr_t overflow_base =
+        reinterpret_cast<std::uintptr_t>(_overflow.back().get());
+    return reinterpret_cast<void *>(
+        (overflow_base + alignment - 1) & ~std::uintptr_t(alignment - 1));
+}
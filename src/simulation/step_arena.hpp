@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Bump allocator storing the scratch data of a simulation step.
+// All the allocations are released at once by reset(), at the beginning of
+// each step. If a step needs more memory than the capacity, the extra
+// allocations go to the heap and the buffer is enlarged at the next reset, so
+// that the steady state doesn't allocate anything.
+class StepArena
+{
+public:
+    explicit StepArena(std::size_t capacity = 64 * 1024);
+
+    // Allocate an array of count default constructed elements, valid until
+    // the next reset()
+    template <typename T>
+    T *allocate(std::size_t count)
+    {
+        static_assert(std::is_trivially_destructible<T>::value,
+                      "StepArena never calls destructors");
+
+        void *memory = allocate_bytes(count * sizeof(T), alignof(T));
+        T *array = static_cast<T *>(memory);
+        for (std::size_t k = 0; k < count; ++k)
+            new (array + k) T();
+        return array;
+    }
+
+    // Release all the allocations
+    void reset();
+
+    std::size_t used() const;
+    std::size_t capacity() const;
+
+private:
+    void *allocate_bytes(std::size_t size, std::size_t alignment);
+
+    std::vector<std::byte> _buffer;
+    std::size_t _offset = 0;
+    // Total size requested since the last reset, including overflow
+    std::size_t _requested = 0;
+    // Allocations which didn't fit in the buffer since the last reset
+    std::vector<std::unique_ptr<std::byte[]>> _overflow;
+};
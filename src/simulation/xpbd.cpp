@@ -0,0 +1,161 @@
+#include "simulation/xpbd.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "profiling/profiler.hpp"
+#include "simulation/simulation_passes.hpp"
+
+using namespace cgp;
+
+xpbd_multipliers xpbd_multipliers::allocate(
+    const deformable_store &deformables, StepArena &arena)
+{
+    const int N_deformable = deformables.size();
+
+    xpbd_multipliers lambda;
+    lambda.shape = arena.allocate<float *>(N_deformable);
+    lambda.contact = arena.allocate<float *>(N_deformable);
+    for (int kd = 0; kd < N_deformable; ++kd)
+    {
+        lambda.shape[kd] = arena.allocate<float>(deformables[kd].size());
+        lambda.contact[kd] = arena.allocate<float>(deformables[kd].size());
+    }
+    return lambda;
+}
+
+float collision_with_planets_xpbd(deformable_store &deformables,
+                                  const bounding_box *bbox,
+                                  const std::vector<Planet> &planets,
+                                  simulation_parameter const &param,
+                                  xpbd_multipliers &lambda)
+{
+    scoped_timer timer(phase_collision_planets);
+
+    const float r = param.collision_radius; // radius of colliding sphere
+
+    const int N_deformable = deformables.size();
+    long long bbox_tests = 0;
+    long long vertex_pair_tests = 0;
+    long long contacts_resolved = 0;
+    float max_correction = 0.0f;
+    for (int i = 0; i < N_deformable; i++)
+    {
+        shape_deformable_structure &deformable = deformables[i];
+        if (!deformable.solving)
+        {
+            continue;
+        }
+        float *lambda_contact = lambda.contact[i];
+        // Compliance scaled by the time step of the shape
+        const float dt = deformable.step_dt;
+        const float alpha = param.contact_compliance / (dt * dt);
+
+        for (const Planet &planet : planets)
+        {
+            ++bbox_tests;
+            if (!bounding_box::collide(bbox[i], planet.get_bounding_box()))
+            {
+                continue;
+            }
+
+            vertex_pair_tests += deformable.size();
+            const vec3 &planet_center = planet.get_center();
+            const float distance_min = r + planet.get_radius();
+            for (int k = 0; k < deformable.size(); ++k)
+            {
+                vec3 &p = deformable.position_predict[k];
+                const vec3 from_planet = p - planet_center;
+                const float n = norm(from_planet);
+
+                // Inequality constraint C = n - distance_min >= 0
+                const float C = n - distance_min;
+                if (C >= 0 || n < 1e-6f)
+                {
+                    continue;
+                }
+
+                // The planet has an infinite mass: only the particle moves
+                float delta_lambda = (-C - alpha * lambda_contact[k])
+                    / (1.0f + alpha);
+                // The contact can only push the particle out of the planet
+                delta_lambda = std::max(delta_lambda, -lambda_contact[k]);
+                lambda_contact[k] += delta_lambda;
+
+                p += (delta_lambda / n) * from_planet;
+                max_correction =
+                    std::max(max_correction, std::abs(delta_lambda));
+                ++contacts_resolved;
+            }
+        }
+    }
+
+    profiler.add_count(counter_bbox_tests, bbox_tests);
+    profiler.add_count(counter_vertex_pair_tests, vertex_pair_tests);
+    profiler.add_count(counter_contacts_resolved, contacts_resolved);
+    return max_correction;
+}
+
+float shape_matching_xpbd(deformable_store &deformables,
+                          simulation_parameter const &param,
+                          xpbd_multipliers &lambda)
+{
+    scoped_timer timer(phase_shape_matching);
+
+    float max_displacement = 0.0f;
+    const int N_deformable = deformables.size();
+    for (int kd = 0; kd < N_deformable; ++kd)
+    {
+        shape_deformable_structure &deformable = deformables[kd];
+        if (!deformable.solving || !deformable.got_black_holed.is_null())
+        {
+            continue;
+        }
+        float *lambda_shape = lambda.shape[kd];
+        // Compliance scaled by the time step of the shape
+        const float dt = deformable.step_dt;
+        const float alpha = param.shape_compliance / (dt * dt);
+
+        // Best rigid transform between the current and predicted shapes, as
+        // in the PPD shape matching
+        deformable.com = center_of_mass(deformable.position_predict);
+        deformable.com_reference = center_of_mass(deformable.position);
+        mat3 T = mat3::build_zero();
+        for (int i = 0; i < deformable.size(); i++)
+        {
+            T += tensor_product(deformable.position_predict[i] - deformable.com,
+                                deformable.position[i]
+                                - deformable.com_reference);
+        }
+        const mat3 R = polar_decomposition(T);
+
+        // Largest distance left between a particle and its goal
+        float goal_distance = 0.0f;
+        for (int i = 0; i < deformable.size(); i++)
+        {
+            vec3 &p = deformable.position_predict[i];
+            const vec3 goal =
+                R * (deformable.position[i] - deformable.com_reference)
+                + deformable.com;
+
+            // Distance constraint C = |p - goal| = 0, the goal is fixed
+            const vec3 to_goal = p - goal;
+            const float C = norm(to_goal);
+            if (C < 1e-7f)
+            {
+                goal_distance = std::max(goal_distance, C);
+                continue;
+            }
+
+            const float delta_lambda = (-C - alpha * lambda_shape[i])
+                / (1.0f + alpha);
+            lambda_shape[i] += delta_lambda;
+            p += (delta_lambda / C) * to_goal;
+            max_displacement =
+                std::max(max_displacement, std::abs(delta_lambda));
+            goal_distance = std::max(goal_distance, std::abs(C + delta_lambda));
+        }
+        place_sphere_tree(deformable, R, goal_distance);
+    }
+    return max_displacement;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "simulation/simulation.hpp"
+
+// Constraint projections of the XPBD solver mode (extended position based
+// dynamics). Each constraint has a compliance (inverse stiffness) scaled by
+// 1/dt^2 and an accumulated Lagrange multiplier, so that the stiffness
+// doesn't depend on the time step nor on the number of iterations.
+
+// Lagrange multipliers of one simulation step, one value per vertex of each
+// deformable shape (indexed as the deformables)
+struct xpbd_multipliers
+{
+    // Multipliers of the shape matching goal constraints
+    float **shape = nullptr;
+    // Multipliers of the contact constraints with the planets
+    float **contact = nullptr;
+
+    // Allocate the multipliers of all the vertices set to zero
+    static xpbd_multipliers allocate(const deformable_store &deformables,
+                                     StepArena &arena);
+};
+
+// Compute the collision between the particles and the planets as compliant
+// contact constraints, return the largest correction applied to a particle
+float collision_with_planets_xpbd(deformable_store &deformables,
+                                  const cgp::bounding_box *bbox,
+                                  const std::vector<Planet> &planets,
+                                  simulation_parameter const &param,
+                                  xpbd_multipliers &lambda);
+
+// Pull each vertex toward its shape matching goal position as a compliant
+// distance constraint, return the largest displacement of a particle
+float shape_matching_xpbd(deformable_store &deformables,
+                          simulation_parameter const &param,
+                          xpbd_multipliers &lambda);
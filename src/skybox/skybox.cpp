@@ -34,10 +34,13 @@ float Skybox::get_distance_from_player() const
 
 void Skybox::update_mesh_from_camera(const cgp::camera_orbit_euler& camera)
 {
-    _drawable.clear();
+    // No OpenGL call: can run on any thread, the upload is done by
+    // update_drawable
     const cgp::vec3 &camera_center = camera.center_of_rotation;
     _mesh = cgp::mesh_primitive_sphere(_distance_from_player, camera_center, _Nu, _Nv);
-    initialize_data_on_gpu();
+    _position = _mesh.position;
+    _connectivity = _mesh.connectivity;
+    cgp::normal_per_vertex(_position, _connectivity, _normal);
 }
 
 cgp::mesh Skybox::get_mesh()
@@ -66,8 +69,15 @@ void Skybox::initialize_data_on_gpu()
 
 cgp::mesh_drawable Skybox::update_drawable()
 {
+    // The drawable of the constructor has a finer mesh: it is replaced once,
+    // then only its vertices are updated
+    if (!_drawable_from_camera)
+    {
+        _drawable.clear();
+        initialize_data_on_gpu();
+        _drawable_from_camera = true;
+    }
     _drawable.vbo_position.update(_position);
-    cgp::normal_per_vertex(_position, _connectivity, _normal);
     _drawable.vbo_normal.update(_normal);
     return _drawable;
 }
\ No newline at end of file
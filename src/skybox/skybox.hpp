@@ -18,9 +18,11 @@ class Skybox
         const fs::path& get_texture_path() const;
         float get_distance_from_player() const;
 
+        // Recompute the mesh around the camera (no OpenGL call)
         void update_mesh_from_camera(const cgp::camera_orbit_euler& camera);
         cgp::mesh get_mesh();
         void initialize_data_on_gpu();
+        // Send the mesh to the GPU (main thread)
         cgp::mesh_drawable update_drawable();
 
     private:
@@ -29,6 +31,8 @@ class Skybox
         int _Nv = 16;
         cgp::mesh _mesh;
         cgp::mesh_drawable _drawable;
+        // Whether the drawable holds the mesh computed around the camera
+        bool _drawable_from_camera = false;
         fs::path _texture_path;
         float _distance_from_player;
 
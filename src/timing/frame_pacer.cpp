@@ -0,0 +1,129 @@
+#include "timing/frame_pacer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <timeapi.h>
+#pragma comment(lib, "winmm")
+#endif
+
+namespace
+{
+    using milliseconds = std::chrono::duration<double, std::milli>;
+
+    // Bounds of the spin margin (ms)
+    constexpr double min_spin_margin = 0.2;
+    constexpr double max_spin_margin = 4.0;
+} // namespace
+
+FramePacer::FramePacer()
+{
+#if defined(_WIN32)
+    // Sleeps of 1 ms instead of the default 15.6 ms scheduler tick
+    timeBeginPeriod(1);
+#endif
+}
+
+FramePacer::~FramePacer()
+{
+#if defined(_WIN32)
+    timeEndPeriod(1);
+#endif
+}
+
+void FramePacer::wait_next_frame(float fps_max)
+{
+    const clock::duration period = std::chrono::duration_cast<clock::duration>(
+        std::chrono::duration<double>(1.0 / std::max(fps_max, 1.0f)));
+    const clock::time_point now = clock::now();
+    if (!_started)
+    {
+        _started = true;
+        _deadline = now + period;
+        _last_frame = now;
+        return;
+    }
+
+    double spin = 0.0;
+    if (now >= _deadline)
+    {
+        // Late: this frame starts now, the next ones are spaced from it
+        ++_missed_deadlines;
+        _missed.add_sample(1.0f);
+        _deadline = now;
+    }
+    else
+    {
+        _missed.add_sample(0.0f);
+
+        // Sleep for most of the time left
+        const clock::time_point wake_up =
+            _deadline
+            - std::chrono::duration_cast<clock::duration>(
+                milliseconds(_spin_margin));
+        if (now < wake_up)
+        {
+            std::this_thread::sleep_until(wake_up);
+            // Keep twice the oversleeps as margin (smoothed)
+            const double oversleep =
+                milliseconds(clock::now() - wake_up).count();
+            _spin_margin = std::clamp(0.9 * _spin_margin + 0.2 * oversleep,
+                                      min_spin_margin, max_spin_margin);
+        }
+
+        // Spin for the rest
+        const clock::time_point spin_start = clock::now();
+        while (clock::now() < _deadline)
+        {
+            std::this_thread::yield();
+        }
+        spin = milliseconds(clock::now() - spin_start).count();
+    }
+
+    const clock::time_point frame = clock::now();
+    const double interval = milliseconds(frame - _last_frame).count();
+    _frame_interval.add_sample(float(interval));
+    _jitter.add_sample(
+        float(std::abs(interval - milliseconds(period).count())));
+    _spin_time.add_sample(float(spin));
+    _last_frame = frame;
+    _deadline += period;
+}
+
+void FramePacer::reset()
+{
+    _started = false;
+}
+
+const rolling_statistics &FramePacer::frame_interval() const
+{
+    return _frame_interval;
+}
+
+const rolling_statistics &FramePacer::jitter() const
+{
+    return _jitter;
+}
+
+const rolling_statistics &FramePacer::spin_time() const
+{
+    return _spin_time;
+}
+
+long long FramePacer::missed_deadlines() const
+{
+    return _missed_deadlines;
+}
+
+int FramePacer::recent_missed_deadlines() const
+{
+    return int(std::lround(_missed.average() * _missed.count));
+}
+
+double FramePacer::spin_margin() const
+{
+    return _spin_margin;
+}
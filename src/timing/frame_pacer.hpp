@@ -0,0 +1,54 @@
+#pragma once
+
+#include <chrono>
+
+#include "profiling/profiler.hpp"
+
+// Limits the frame rate without keeping a core busy: the thread sleeps for
+// most of the time left before the deadline of the next frame, and only spins
+// for the last spin margin, the sleeps of the OS being too coarse to wake up
+// on time. The margin follows the oversleeps measured.
+// The deadlines are spaced by the target period; a frame ready after its
+// deadline is counted as missed, and the next deadlines start from it (no
+// catching up with faster frames).
+class FramePacer
+{
+public:
+    FramePacer();
+    ~FramePacer();
+
+    FramePacer(const FramePacer &) = delete;
+    FramePacer &operator=(const FramePacer &) = delete;
+
+    // Wait until the deadline of the next frame at the given rate
+    void wait_next_frame(float fps_max);
+    // Forget the deadlines (the limiter is off)
+    void reset();
+
+    // Statistics over the last frames (ms): interval between two frames,
+    // distance of the interval to the target period, time spent spinning
+    const rolling_statistics &frame_interval() const;
+    const rolling_statistics &jitter() const;
+    const rolling_statistics &spin_time() const;
+    // Frames ready after their deadline, since the start and among the last
+    // frames
+    long long missed_deadlines() const;
+    int recent_missed_deadlines() const;
+    // Time before the deadline at which the sleep stops (ms)
+    double spin_margin() const;
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    bool _started = false;
+    clock::time_point _deadline;
+    clock::time_point _last_frame;
+    double _spin_margin = 1.0;
+
+    rolling_statistics _frame_interval;
+    rolling_statistics _jitter;
+    rolling_statistics _spin_time;
+    // 1 for each missed deadline, 0 otherwise
+    rolling_statistics _missed;
+    long long _missed_deadlines = 0;
+};
@@ -0,0 +1,150 @@
+#include "validation/golden_state.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+using namespace cgp;
+
+namespace
+{
+    // Identifies the file and the version of its layout
+    const char golden_magic[8] = { 'S', 'M', 'G', 'G', 'O', 'L', 'D', '1' };
+
+    template <typename T>
+    void write_value(std::ofstream &file, const T &value)
+    {
+        file.write(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    bool read_value(std::ifstream &file, T &value)
+    {
+        file.read(reinterpret_cast<char *>(&value), sizeof(T));
+        return bool(file);
+    }
+} // namespace
+
+golden_state golden_state::from_deformables(const deformable_store &deformables,
+                                            int steps)
+{
+    golden_state state;
+    state.steps = steps;
+    for (const shape_deformable_structure &deformable : deformables)
+    {
+        state.positions.push_back(deformable.position);
+    }
+    return state;
+}
+
+bool golden_state::save(const std::string &filename) const
+{
+    std::ofstream file(filename, std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+
+    file.write(golden_magic, sizeof(golden_magic));
+    write_value(file, std::int32_t(steps));
+    write_value(file, std::int32_t(positions.size()));
+    for (const numarray<vec3> &shape : positions)
+    {
+        write_value(file, std::int32_t(shape.size()));
+        for (const vec3 &p : shape)
+        {
+            write_value(file, p.x);
+            write_value(file, p.y);
+            write_value(file, p.z);
+        }
+    }
+    return bool(file);
+}
+
+bool golden_state::load(const std::string &filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    char magic[sizeof(golden_magic)];
+    if (!file.read(magic, sizeof(magic))
+        || std::memcmp(magic, golden_magic, sizeof(magic)) != 0)
+    {
+        return false;
+    }
+
+    std::int32_t step_count = 0;
+    std::int32_t shape_count = 0;
+    if (!read_value(file, step_count) || !read_value(file, shape_count)
+        || shape_count < 0)
+    {
+        return false;
+    }
+    steps = step_count;
+    positions.assign(shape_count, numarray<vec3>());
+    for (numarray<vec3> &shape : positions)
+    {
+        std::int32_t vertex_count = 0;
+        if (!read_value(file, vertex_count) || vertex_count < 0)
+        {
+            return false;
+        }
+        shape.resize(vertex_count);
+        for (vec3 &p : shape)
+        {
+            if (!read_value(file, p.x) || !read_value(file, p.y)
+                || !read_value(file, p.z))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool golden_comparison::passed(float tolerance) const
+{
+    return same_layout && max_deviation <= tolerance;
+}
+
+golden_comparison compare_golden_state(const golden_state &golden,
+                                       const golden_state &state)
+{
+    golden_comparison comparison;
+    comparison.same_layout = golden.positions.size() == state.positions.size();
+    for (int s = 0; comparison.same_layout && s < golden.positions.size(); ++s)
+    {
+        comparison.same_layout =
+            golden.positions[s].size() == state.positions[s].size();
+    }
+    if (!comparison.same_layout)
+    {
+        return comparison;
+    }
+
+    // Accumulated in double: scenes can have millions of particles
+    double squared_sum = 0.0;
+    for (int s = 0; s < golden.positions.size(); ++s)
+    {
+        const numarray<vec3> &expected = golden.positions[s];
+        const numarray<vec3> &actual = state.positions[s];
+        for (int k = 0; k < expected.size(); ++k)
+        {
+            const float deviation = norm(actual[k] - expected[k]);
+            squared_sum += double(deviation) * deviation;
+            // A NaN is always reported as the largest deviation
+            if (deviation > comparison.max_deviation || std::isnan(deviation))
+            {
+                comparison.max_deviation = deviation;
+                comparison.max_shape = s;
+                comparison.max_vertex = k;
+            }
+        }
+        comparison.vertices += expected.size();
+    }
+    if (comparison.vertices > 0)
+    {
+        comparison.rms_deviation =
+            float(std::sqrt(squared_sum / comparison.vertices));
+    }
+    return comparison;
+}
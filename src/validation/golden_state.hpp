@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "cgp/cgp.hpp"
+#include "deformable/deformable.hpp"
+
+// Positions of the particles of every shape after a given number of steps of
+// a reference scene, recorded once with the reference code path and compared
+// with the positions computed by any other path (other solver, vector
+// instructions, threads...).
+//
+// The run is deterministic as long as the scene is: the shapes come from the
+// scene file, and the steps don't depend on the display (fixed time step).
+struct golden_state
+{
+    // Simulation steps run from the initial state of the scene
+    int steps = 0;
+    // Positions of each shape, in the order of the deformables
+    std::vector<cgp::numarray<cgp::vec3>> positions;
+
+    static golden_state from_deformables(const deformable_store &deformables,
+                                         int steps);
+
+    // Binary file: header, number of shapes, then for each shape its number of
+    // vertices and its positions (floats)
+    bool save(const std::string &filename) const;
+    bool load(const std::string &filename);
+};
+
+// Deviation of the positions from the golden ones
+struct golden_comparison
+{
+    // Same number of shapes, and of vertices per shape (otherwise the
+    // deviations are not computed)
+    bool same_layout = true;
+    int vertices = 0;
+    float max_deviation = 0.0f;
+    float rms_deviation = 0.0f;
+    // Shape and vertex of the largest deviation
+    int max_shape = -1;
+    int max_vertex = -1;
+
+    bool passed(float tolerance) const;
+};
+
+golden_comparison compare_golden_state(const golden_state &golden,
+                                       const golden_state &state);